@@ -0,0 +1,678 @@
+/**
+ * Microbenchmarks for the intersection, texture and shading kernels and the OBJ loader.
+ *
+ * Every benchmark runs batches of operations on inputs drawn from a fixed
+ * seed until --min-time seconds have passed and reports the time per
+ * operation and the rays traced per second. Run it from the build directory,
+ * like the renderer, so that the scenes find their textures:
+ *
+ *     ./ray_bench [--filter text] [--min-time seconds] [--scenes dir]
+ */
+
+#include "bvh.h"
+#include "image.h"
+#include "mesh.h"
+#include "meshfile.h"
+#include "objloader.h"
+#include "primitives.h"
+#include "raytracer.h"
+#include "scene.h"
+#include "stats.h"
+#include "texture.h"
+#include "triangleblock.h"
+#include "shapes/cone.h"
+#include "shapes/cylinder.h"
+#include "shapes/meshobject.h"
+#include "shapes/sphere.h"
+#include "shapes/triangle.h"
+
+#include <dirent.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+namespace {
+
+unsigned const SEED = 42;
+size_t const RAY_COUNT = 4096;
+
+double min_time = 0.5;
+string filter;
+string scenes_dir = "../Scenes";
+
+// Results are folded into this, so that the compiler cannot drop the work
+volatile double sink;
+
+/**
+ * Times batch() until min_time has passed, after one warm-up run. A batch
+ * performs 'ops' operations that trace 'rays' rays in total (0 when the
+ * operation is not about rays, e.g. a texture lookup).
+ */
+template<typename Batch>
+void run(string const &name, size_t ops, double rays, Batch &&batch) {
+    if (!filter.empty() && name.find(filter) == string::npos) {
+        return;
+    }
+    batch();
+    size_t batches = 0;
+    Stopwatch watch;
+    double elapsed;
+    do {
+        batch();
+        ++batches;
+        elapsed = watch.seconds();
+    } while (elapsed < min_time);
+
+    double ns_per_op = 1e9 * elapsed / (batches * ops);
+    printf("%-56s %12.1f ns/op", name.c_str(), ns_per_op);
+    if (rays > 0) {
+        printf(" %14.0f rays/s", batches * rays / elapsed);
+    }
+    printf(" %10zu ops\n", batches * ops);
+}
+
+// Rays from a shell around 'target' towards points scattered around it, so that some hit and some miss
+vector<Ray> aimedRays(Point const &target, double distance, double spread) {
+    mt19937 rng(SEED);
+    normal_distribution<double> gauss;
+    uniform_real_distribution<double> offset(-spread, spread);
+    vector<Ray> rays;
+    rays.reserve(RAY_COUNT);
+    while (rays.size() < RAY_COUNT) {
+        Vector dir(gauss(rng), gauss(rng), gauss(rng));
+        if (dir.length() < 1e-6) {
+            continue;
+        }
+        Point origin = target + distance * dir.normalized();
+        Point aim = target + Vector(offset(rng), offset(rng), offset(rng));
+        rays.push_back(Ray(origin, (aim - origin).normalized()));
+    }
+    return rays;
+}
+
+template<typename Shape>
+void benchIntersect(string const &name, Shape const &shape, vector<Ray> const &rays) {
+    run(name + "::intersect", rays.size(), rays.size(), [&] {
+        double sum = 0;
+        for (Ray const &ray : rays) {
+            Hit hit = shape.intersect(ray);
+            sum += std::isnan(hit.t) ? 0 : hit.t;
+        }
+        sink = sum;
+    });
+    run(name + "::occluded", rays.size(), rays.size(), [&] {
+        unsigned blocked = 0;
+        for (Ray const &ray : rays) {
+            blocked += shape.occluded(ray, 1e4);
+        }
+        sink = blocked;
+    });
+}
+
+void benchShapes() {
+    Sphere sphere(Point(200, 200, 0), 100);
+    benchIntersect("Sphere", sphere, aimedRays(sphere.center, 1000, 150));
+
+    Triangle triangle(Point(100, 100, 0), Point(300, 100, 0), Point(200, 300, 0));
+    benchIntersect("Triangle", triangle, aimedRays(Point(200, 167, 0), 1000, 150));
+
+    Cone cone(Point(200, 400, 0), Vector(0, -1, 0), 20);
+    benchIntersect("Cone", cone, aimedRays(Point(200, 300, 0), 1000, 150));
+
+    Cylinder cylinder(Point(200, 100, 0), 80, 200);
+    benchIntersect("Cylinder", cylinder, aimedRays(Point(200, 200, 0), 1000, 150));
+
+    // The textured sphere of the bundled scene is rotated
+    Sphere earth(Point(140, 220, 400), 50, Vector(0, 1, 0.7), 90);
+    mt19937 rng(SEED);
+    normal_distribution<double> gauss;
+    vector<Point> surface;
+    while (surface.size() < RAY_COUNT) {
+        Vector dir(gauss(rng), gauss(rng), gauss(rng));
+        if (dir.length() > 1e-6) {
+            surface.push_back(earth.center + earth.radius * dir.normalized());
+        }
+    }
+    run("Sphere::mapTextureCoord", surface.size(), 0, [&] {
+        double sum = 0;
+        for (Point const &point : surface) {
+            auto coord = earth.mapTextureCoord(point);
+            sum += coord.first + coord.second;
+        }
+        sink = sum;
+    });
+}
+
+void benchTexture() {
+    string filename = scenes_dir + "/earthmap1k.png";
+    Image texture(filename);
+    if (texture.size() == 0) {
+        cerr << "Skipping Image::colorAt: could not read " << filename << '\n';
+        return;
+    }
+    mt19937 rng(SEED);
+    uniform_real_distribution<float> unit(0.0f, 1.0f);
+    vector<pair<float, float>> coords(RAY_COUNT);
+    for (auto &coord : coords) {
+        coord = make_pair(unit(rng), unit(rng));
+    }
+    run("Image::colorAt", coords.size(), 0, [&] {
+        double sum = 0;
+        for (auto const &coord : coords) {
+            sum += texture.colorAt(coord.first, coord.second).r;
+        }
+        sink = sum;
+    });
+
+    // The same lookups in the RGBA8 texture, and the filtered ones at random levels of detail
+    Texture compact(texture);
+    run("Texture::colorAt", coords.size(), 0, [&] {
+        double sum = 0;
+        for (auto const &coord : coords) {
+            sum += compact.colorAt(coord.first, coord.second).r;
+        }
+        sink = sum;
+    });
+    run("Texture::bilinear", coords.size(), 0, [&] {
+        double sum = 0;
+        for (auto const &coord : coords) {
+            sum += compact.bilinear(coord.first, coord.second, 0).r;
+        }
+        sink = sum;
+    });
+    uniform_real_distribution<float> level(0.0f, compact.numLevels() - 1.0f);
+    vector<float> lods(coords.size());
+    for (float &lod : lods) {
+        lod = level(rng);
+    }
+    run("Texture::trilinear", coords.size(), 0, [&] {
+        double sum = 0;
+        for (size_t idx = 0; idx < coords.size(); ++idx) {
+            sum += compact.trilinear(coords[idx].first, coords[idx].second, lods[idx]).r;
+        }
+        sink = sum;
+    });
+}
+
+// Random triangles of a few pixels in front of the eye, packed 8 to a block as in a mesh leaf
+void benchTriangleBlocks() {
+    mt19937 rng(SEED);
+    uniform_real_distribution<double> position(0, 400), corner(-10, 10), depth(-50, 50);
+    size_t const block_count = 256;
+    vector<TriangleBlock> blocks(block_count);
+    vector<Point> corners;
+    for (TriangleBlock &block : blocks) {
+        Point center(position(rng), position(rng), depth(rng));
+        for (int lane = 0; lane < TriangleBlock::WIDTH; ++lane) {
+            Point a = center + Vector(corner(rng), corner(rng), corner(rng)),
+                    b = center + Vector(corner(rng), corner(rng), corner(rng)),
+                    c = center + Vector(corner(rng), corner(rng), corner(rng));
+            block.add(a, b, c, static_cast<unsigned>(corners.size() / 3));
+            corners.insert(corners.end(), {a, b, c});
+        }
+    }
+    Point eye(200, 200, 1000);
+    vector<Ray> rays;
+    for (TriangleBlock const &block : blocks) {
+        Point aim = block.anchor + Vector(corner(rng), corner(rng), 0);
+        rays.push_back(Ray(eye, (aim - eye).normalized()));
+    }
+    vector<BlockRay> block_rays;
+    for (size_t index = 0; index < block_count; ++index) {
+        block_rays.push_back(BlockRay(blocks[index], rays[index], numeric_limits<double>::infinity()));
+    }
+
+    auto benchKernel = [&](string const &name, TriangleBlockKernel kernel) {
+        run("TriangleBlock/" + name, block_count, block_count, [&] {
+            unsigned hits = 0;
+            for (size_t index = 0; index < block_count; ++index) {
+                hits += __builtin_popcount(kernel(blocks[index], block_rays[index]));
+            }
+            sink = hits;
+        });
+    };
+    // The reference: the exact double precision test of every triangle of the block
+    run("TriangleBlock/double", block_count, block_count, [&] {
+        double sum = 0;
+        for (size_t index = 0; index < block_count; ++index) {
+            for (int lane = 0; lane < TriangleBlock::WIDTH; ++lane) {
+                size_t first = 3 * (TriangleBlock::WIDTH * index + lane);
+                double t = Triangle::distance(corners[first], corners[first + 1], corners[first + 2], rays[index]);
+                sum += std::isnan(t) ? 0 : t;
+            }
+        }
+        sink = sum;
+    });
+    benchKernel("scalar", intersectBlockScalar);
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+    benchKernel("sse", intersectBlockSSE);   // part of every x86-64 CPU
+    if (__builtin_cpu_supports("avx2")) {
+        benchKernel("avx2", intersectBlockAVX2);
+    }
+#endif
+}
+
+// Mixed random spheres and triangles behind a BVH, tested once through
+// virtual calls per object and once through the type tags of PrimitiveTable
+void benchPrimitiveTable() {
+    mt19937 rng(SEED);
+    uniform_real_distribution<double> position(0, 400), corner(-10, 10), size(2, 10);
+    vector<ObjectPtr> objects;
+    for (int index = 0; index < 1024; ++index) {
+        Point center(position(rng), position(rng), position(rng) - 200);
+        if (index % 2 == 0) {
+            objects.push_back(make_shared<Sphere>(center, size(rng)));
+        } else {
+            objects.push_back(make_shared<Triangle>(center + Vector(corner(rng), corner(rng), corner(rng)),
+                                                    center + Vector(corner(rng), corner(rng), corner(rng)),
+                                                    center + Vector(corner(rng), corner(rng), corner(rng))));
+        }
+    }
+    vector<AABB> bounds;
+    for (ObjectPtr const &object : objects) {
+        bounds.push_back(object->boundingBox());
+    }
+    BVH bvh;
+    bvh.build(bounds, 8);
+    vector<Object const *> ordered;
+    for (unsigned index : bvh.order()) {
+        ordered.push_back(objects[index].get());
+    }
+    PrimitiveTable table;
+    table.build(ordered, bvh);
+    vector<Ray> rays = aimedRays(Point(200, 200, 0), 1000, 200);
+
+    run("Primitives/virtual", rays.size(), rays.size(), [&] {
+        double sum = 0;
+        for (Ray const &ray : rays) {
+            double t_max = numeric_limits<double>::infinity();
+            bvh.intersect(ray, t_max, [&](unsigned pos, double &t_max) {
+                Hit hit(ordered[pos]->intersect(ray));
+                if (hit.t < t_max) {
+                    t_max = hit.t;
+                }
+            });
+            sum += std::isinf(t_max) ? 0 : t_max;
+        }
+        sink = sum;
+    });
+    run("Primitives/table", rays.size(), rays.size(), [&] {
+        double sum = 0;
+        for (Ray const &ray : rays) {
+            double t_max = numeric_limits<double>::infinity();
+            Hit min_hit(t_max, Vector());
+            bvh.traverse(ray, t_max, [&](unsigned first, unsigned, double &t_max) {
+                if (table.intersectLeaf(first, ray, min_hit)) {
+                    t_max = min_hit.t;
+                }
+            });
+            sum += std::isinf(t_max) ? 0 : t_max;
+        }
+        sink = sum;
+    });
+}
+
+vector<string> sceneFiles() {
+    vector<string> files;
+    DIR *dir = opendir(scenes_dir.c_str());
+    if (!dir) {
+        cerr << "Skipping the scenes: could not open " << scenes_dir << '\n';
+        return files;
+    }
+    while (dirent *entry = readdir(dir)) {
+        string name = entry->d_name;
+        if (name.size() > 5 && name.compare(name.size() - 5, 5, ".json") == 0) {
+            files.push_back(scenes_dir + "/" + name);
+        }
+    }
+    closedir(dir);
+    sort(files.begin(), files.end());
+    return files;
+}
+
+struct PrimaryHit {
+    Ray ray;
+    Object const *object;
+    Hit hit;
+};
+
+/**
+ * The Phong light loop of Scene::shade without shadow and reflection rays,
+ * once as Triple expressions with temporaries (as shade was written before
+ * the fused operations) and once with the fused operations it uses now.
+ */
+Color phongWithTemporaries(Scene const &scene, PrimaryHit const &primary) {
+    Material const &material = scene.getMaterial(primary.object->material_id);
+    Point hit = primary.ray.at(primary.hit.t);
+    Vector N = primary.hit.N, V = -primary.ray.D;
+    Color color = material.color * material.ka;
+    for (LightPtr const &light : scene.getLights()) {
+        Vector L = (light->position - hit).normalized(),
+                R = 2 * N.dot(L) * N - L;
+        double diffuse = L.dot(N), specular = R.dot(V);
+        if (diffuse > 0) {
+            color += diffuse * material.color * light->color * material.kd;
+        }
+        if (specular > 0) {
+            color += pow(specular, material.n) * light->color * material.ks;
+        }
+    }
+    return color;
+}
+
+Color phongFused(Scene const &scene, PrimaryHit const &primary) {
+    Material const &material = scene.getMaterial(primary.object->material_id);
+    Point hit = primary.ray.at(primary.hit.t);
+    Vector N = primary.hit.N, V = -primary.ray.D;
+    Color color = material.color * material.ka;
+    for (LightPtr const &light : scene.getLights()) {
+        Vector L = (light->position - hit).normalized(),
+                R = -Vector::reflect(L, N);
+        double diffuse = L.dot(N), specular = R.dot(V);
+        if (diffuse > 0) {
+            color.addProduct(diffuse, material.color, light->color, material.kd);
+        }
+        if (specular > 0) {
+            color.addScaled(pow(specular, material.n), light->color, material.ks);
+        }
+    }
+    return color;
+}
+
+// Shading cost per primary hit: the Phong kernels above, and Scene::shade with its shadow and reflection rays
+void benchShading(string const &name, Scene const &scene, Tile const &region) {
+    vector<PrimaryHit> hits;
+    for (unsigned py = region.y0; py < region.y1; ++py) {
+        for (unsigned px = region.x0; px < region.x1; ++px) {
+            Ray ray = scene.primaryRay(px, py, 0.5, 0.5);
+            Hit hit(numeric_limits<double>::infinity(), Vector());
+            if (Object const *object = scene.findHit(ray, hit)) {
+                hits.push_back(PrimaryHit{ray, object, hit});
+            }
+        }
+    }
+    if (hits.empty()) {
+        return;
+    }
+    auto benchKernel = [&](string const &kernel_name, Color (*kernel)(Scene const &, PrimaryHit const &)) {
+        run("Shading/" + kernel_name + "/" + name, hits.size(), 0, [&] {
+            Color sum;
+            for (PrimaryHit const &primary : hits) {
+                sum += kernel(scene, primary);
+            }
+            sink = sum.r + sum.g + sum.b;
+        });
+    };
+    benchKernel("temporaries", phongWithTemporaries);
+    benchKernel("fused", phongFused);
+    run("Scene::shade/" + name, hits.size(), 0, [&] {
+        Color sum;
+        for (PrimaryHit const &primary : hits) {
+            sum += scene.shade(primary.ray, primary.object, primary.hit);
+        }
+        sink = sum.r + sum.g + sum.b;
+    });
+}
+
+uint64_t secondaryRays(RenderCounters const &counters) {
+    return counters.shadow_rays + counters.reflection_rays;
+}
+
+/**
+ * Misses of the texel reads of colorAt in a simulated 32 KB, 8-way L1 data
+ * cache with LRU replacement (the hardware counters are not always there).
+ */
+double simulatedMisses(Texture const &texture, vector<pair<float, float>> const &coords) {
+    size_t const LINE = 64, SETS = 64, WAYS = 8;
+    vector<uintptr_t> tags(SETS * WAYS, 0);     // per set, the most recent first
+    size_t misses = 0;
+    for (auto const &coord : coords) {
+        uintptr_t line = reinterpret_cast<uintptr_t>(texture.data() + texture.nearest(coord.first, coord.second)) /
+                         LINE + 1;
+        uintptr_t *set = &tags[(line % SETS) * WAYS];
+        size_t way = 0;
+        while (way < WAYS - 1 && set[way] != line) {
+            ++way;
+        }
+        misses += set[way] != line;
+        copy_backward(set, set + way, set + way + 1);
+        set[0] = line;
+    }
+    return double(misses) / coords.size();
+}
+
+/**
+ * The texel layouts on the access pattern of a high resolution render: a
+ * rotated earth fills a 2048x2048 frame and is sampled pixel by pixel in the
+ * order of the render tiles. earthmap1k is scaled up 4x to 4000x2000, the
+ * size of a texture that such a frame would use, so that it does not fit
+ * into the caches either.
+ */
+void benchTextureLayout() {
+    string filename = scenes_dir + "/earthmap1k.png";
+    Image earth(filename);
+    if (earth.size() == 0) {
+        cerr << "Skipping the texture layouts: could not read " << filename << '\n';
+        return;
+    }
+    unsigned const SCALE = 4, FRAME = 2048, TILE = 16;    // the tiles of Scene::render
+    Image large(earth.width() * SCALE, earth.height() * SCALE);
+    for (unsigned y = 0; y < large.height(); ++y) {
+        for (unsigned x = 0; x < large.width(); ++x) {
+            large.put_pixel(x, y, Color(earth(x / SCALE, y / SCALE)));
+        }
+    }
+
+    Sphere sphere(Point(200, 200, 0), 190, Vector(0, 1, 0.7), 90);
+    Scene scene;
+    scene.setEye(Point(200, 200, 1000));
+    scene.setResolution(FRAME, FRAME);
+    vector<pair<float, float>> coords;
+    for (unsigned y0 = 0; y0 < FRAME; y0 += TILE) {
+        for (unsigned x0 = 0; x0 < FRAME; x0 += TILE) {
+            for (unsigned py = y0; py < y0 + TILE; ++py) {
+                for (unsigned px = x0; px < x0 + TILE; ++px) {
+                    Ray ray(scene.primaryRay(px, py, 0.5, 0.5));
+                    Hit hit(sphere.intersect(ray));
+                    if (!std::isnan(hit.t)) {
+                        coords.push_back(sphere.mapTextureCoord(ray.at(hit.t)));
+                    }
+                }
+            }
+        }
+    }
+
+    for (Texture::Layout layout : {Texture::LINEAR, Texture::TILED}) {
+        string suffix = layout == Texture::LINEAR ? "/linear" : "/tiled";
+        if (!filter.empty() && ("Texture::colorAt" + suffix).find(filter) == string::npos &&
+            ("Texture::bilinear" + suffix).find(filter) == string::npos) {
+            continue;
+        }
+        Texture texture(large, layout);
+        run("Texture::colorAt" + suffix, coords.size(), 0, [&] {
+            double sum = 0;
+            for (auto const &coord : coords) {
+                sum += texture.colorAt(coord.first, coord.second).r;
+            }
+            sink = sum;
+        });
+        run("Texture::bilinear" + suffix, coords.size(), 0, [&] {
+            double sum = 0;
+            for (auto const &coord : coords) {
+                sum += texture.bilinear(coord.first, coord.second, 0).r;
+            }
+            sink = sum;
+        });
+        printf("%-56s %12.4f misses/op (simulated L1)\n", ("Texture::colorAt" + suffix).c_str(),
+               simulatedMisses(texture, coords));
+    }
+}
+
+/**
+ * Both OBJ parsers on a generated sphere of 256 x 512 quads with texture
+ * coordinates and normals (about 12 MB), per face vertex, and a MeshObject
+ * made from the parsed OBJ or from its compiled mesh file (meshfile.h), per
+ * triangle. The files are written to the current directory and removed
+ * again.
+ */
+void benchOBJLoader() {
+    bool wanted = filter.empty();
+    for (char const *name : {"OBJLoader/stream", "OBJLoader/mapped", "MeshObject/obj", "MeshObject/mesh-file"}) {
+        wanted = wanted || string(name).find(filter) != string::npos;
+    }
+    if (!wanted) {
+        return;
+    }
+    unsigned const RINGS = 256, SEGMENTS = 512;
+    string filename = "ray_bench_sphere_" + to_string(getpid()) + ".obj";
+    {
+        ofstream out(filename);
+        out << "# ray_bench sphere\n";
+        for (unsigned ring = 0; ring <= RINGS; ++ring) {
+            for (unsigned segment = 0; segment <= SEGMENTS; ++segment) {
+                double theta = M_PI * ring / RINGS, phi = 2 * M_PI * segment / SEGMENTS;
+                double x = sin(theta) * cos(phi), y = cos(theta), z = sin(theta) * sin(phi);
+                out << "v " << x << ' ' << y << ' ' << z << "\nvn " << x << ' ' << y << ' ' << z
+                    << "\nvt " << double(segment) / SEGMENTS << ' ' << double(ring) / RINGS << '\n';
+            }
+        }
+        for (unsigned ring = 0; ring < RINGS; ++ring) {
+            for (unsigned segment = 0; segment < SEGMENTS; ++segment) {
+                unsigned a = ring * (SEGMENTS + 1) + segment + 1, b = a + 1, c = a + SEGMENTS + 1, d = c + 1;
+                out << "f " << a << '/' << a << '/' << a << ' ' << c << '/' << c << '/' << c << ' '
+                    << d << '/' << d << '/' << d << "\nf " << a << '/' << a << '/' << a << ' '
+                    << d << '/' << d << '/' << d << ' ' << b << '/' << b << '/' << b << '\n';
+            }
+        }
+    }
+
+    vector<Vertex> stream = OBJLoader(filename, OBJLoader::STREAM).vertex_data(),
+            mapped = OBJLoader(filename, OBJLoader::MAPPED).vertex_data();
+    if (stream.size() != mapped.size() ||
+        memcmp(stream.data(), mapped.data(), stream.size() * sizeof(Vertex)) != 0) {
+        cerr << "OBJLoader: the mapped parser differs from the stream parser\n";
+    }
+    for (OBJLoader::Parser parser : {OBJLoader::STREAM, OBJLoader::MAPPED}) {
+        run(parser == OBJLoader::STREAM ? "OBJLoader/stream" : "OBJLoader/mapped", stream.size(), 0, [&] {
+            OBJLoader obj(filename, parser);
+            sink = obj.numTriangles();
+        });
+    }
+
+    // The first Mesh with mesh files on writes the file, the others map it
+    size_t triangles = stream.size() / 3;
+    for (bool mesh_files : {false, true}) {
+        Mesh::setMeshFiles(mesh_files);
+        Mesh first(filename);
+        sink = first.numTriangles();
+        run(mesh_files ? "MeshObject/mesh-file" : "MeshObject/obj", triangles, 0, [&] {
+            MeshObject mesh((Mesh(filename)));
+            sink = mesh.numTriangles();
+        });
+    }
+    Mesh::setMeshFiles(false);
+    remove(MeshFile::path(filename).c_str());
+    remove(filename.c_str());
+}
+
+/**
+ * Scene::trace for the center of every pixel, one ray at a time on this
+ * thread, the shading of the primary hits, and Scene::render of the whole frame on one thread (tiles, packets
+ * and supersampling). rays/s includes shadow and reflection rays.
+ */
+void benchScene(string const &filename) {
+    string name = filename.substr(filename.find_last_of('/') + 1);
+    name.erase(name.size() - 5);
+    bool wanted = filter.empty();
+    for (char const *prefix : {"Scene::trace/", "Scene::render/", "Scene::shade/", "Shading/temporaries/",
+                               "Shading/fused/"}) {
+        wanted = wanted || (prefix + name).find(filter) != string::npos;
+    }
+    if (!wanted) {
+        return;
+    }
+
+    Raytracer raytracer;
+    streambuf *out = cout.rdbuf(nullptr);   // keep "Parsed N objects." out of the table
+    bool ok = raytracer.readScene(filename);
+    cout.rdbuf(out);
+    if (!ok) {
+        cerr << "Skipping " << filename << '\n';
+        return;
+    }
+    raytracer.setThreads(1);
+    Scene const &scene = raytracer.getScene();
+    Tile region = scene.region();
+    size_t pixels = size_t(region.x1 - region.x0) * (region.y1 - region.y0);
+
+    // Count the rays of one frame first, they are the same for every run.
+    // Scene::trace does not count the primary ray, that is up to its caller.
+    RenderCounters before = threadCounters();
+    double sum = 0;
+    for (unsigned py = region.y0; py < region.y1; ++py) {
+        for (unsigned px = region.x0; px < region.x1; ++px) {
+            sum += scene.trace(scene.primaryRay(px, py, 0.5, 0.5)).r;
+        }
+    }
+    RenderCounters after = threadCounters();
+    sink = sum;
+    run("Scene::trace/" + name, pixels, pixels + secondaryRays(after) - secondaryRays(before), [&] {
+        double sum = 0;
+        for (unsigned py = region.y0; py < region.y1; ++py) {
+            for (unsigned px = region.x0; px < region.x1; ++px) {
+                sum += scene.trace(scene.primaryRay(px, py, 0.5, 0.5)).r;
+            }
+        }
+        sink = sum;
+    });
+
+    benchShading(name, scene, region);
+
+    Image img(region.x1 - region.x0, region.y1 - region.y0);
+    RenderCounters frame = scene.render(img);
+    run("Scene::render/" + name, pixels, frame.primary_rays + secondaryRays(frame), [&] {
+        scene.render(img);
+    });
+}
+
+}
+
+int main(int argc, char *argv[]) {
+    for (int idx = 1; idx < argc; ++idx) {
+        string arg = argv[idx];
+        if (arg == "--filter" && idx + 1 < argc) {
+            filter = argv[++idx];
+        } else if (arg == "--min-time" && idx + 1 < argc) {
+            min_time = stod(argv[++idx]);
+        } else if (arg == "--scenes" && idx + 1 < argc) {
+            scenes_dir = argv[++idx];
+        } else {
+            cerr << "Usage: " << argv[0] << " [--filter text] [--min-time seconds] [--scenes dir]\n";
+            return 1;
+        }
+    }
+
+    printf("Triangle block kernel in use: %s\n\n", triangleBlockKernelName());
+    benchShapes();
+    benchTexture();
+    benchTextureLayout();
+    benchTriangleBlocks();
+    benchPrimitiveTable();
+    benchOBJLoader();
+    for (string const &filename : sceneFiles()) {
+        benchScene(filename);
+    }
+    return 0;
+}
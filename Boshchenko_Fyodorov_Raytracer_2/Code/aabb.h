@@ -0,0 +1,163 @@
+#ifndef AABB_H_
+#define AABB_H_
+
+#include "ray.h"
+#include "raypacket.h"
+#include "triple.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+/**
+ * Axis-aligned bounding box. A default constructed box is empty
+ * (min = +inf, max = -inf), so extending it with anything yields that thing.
+ */
+class AABB {
+public:
+    Point min;
+    Point max;
+
+    AABB()
+            :
+            min(std::numeric_limits<double>::infinity(),
+                std::numeric_limits<double>::infinity(),
+                std::numeric_limits<double>::infinity()),
+            max(-std::numeric_limits<double>::infinity(),
+                -std::numeric_limits<double>::infinity(),
+                -std::numeric_limits<double>::infinity()) {}
+
+    AABB(Point const &min, Point const &max)
+            :
+            min(min),
+            max(max) {}
+
+    // A box covering all of space, used by shapes that have no finite extent.
+    static AABB infinite() {
+        double inf = std::numeric_limits<double>::infinity();
+        return AABB(Point(-inf, -inf, -inf), Point(inf, inf, inf));
+    }
+
+    bool isFinite() const {
+        for (int axis = 0; axis < 3; ++axis) {
+            if (std::isinf(min.data[axis]) || std::isinf(max.data[axis])) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    void extend(Point const &p) {
+        for (int axis = 0; axis < 3; ++axis) {
+            min.data[axis] = std::min(min.data[axis], p.data[axis]);
+            max.data[axis] = std::max(max.data[axis], p.data[axis]);
+        }
+    }
+
+    void extend(AABB const &box) {
+        for (int axis = 0; axis < 3; ++axis) {
+            min.data[axis] = std::min(min.data[axis], box.min.data[axis]);
+            max.data[axis] = std::max(max.data[axis], box.max.data[axis]);
+        }
+    }
+
+    Point centroid() const {
+        return Point(0.5 * (min.x + max.x), 0.5 * (min.y + max.y), 0.5 * (min.z + max.z));
+    }
+
+    // Index of the axis with the largest extent.
+    int longestAxis() const {
+        Vector d = max - min;
+        if (d.x > d.y && d.x > d.z) {
+            return 0;
+        }
+        return d.y > d.z ? 1 : 2;
+    }
+
+    double surfaceArea() const {
+        if (min.x > max.x) {
+            return 0;   // empty box
+        }
+        Vector d = max - min;
+        return 2 * (d.x * d.y + d.y * d.z + d.z * d.x);
+    }
+
+    /**
+     * Slab test. inv_dir holds 1 / ray.D per axis. Returns whether the ray
+     * overlaps the box within [t_min, t_max].
+     */
+    bool intersect(Ray const &ray, Vector const &inv_dir, double t_min, double t_max) const {
+        for (int axis = 0; axis < 3; ++axis) {
+            double t0 = (min.data[axis] - ray.O.data[axis]) * inv_dir.data[axis],
+                    t1 = (max.data[axis] - ray.O.data[axis]) * inv_dir.data[axis];
+            if (inv_dir.data[axis] < 0) {
+                std::swap(t0, t1);
+            }
+            // Written so that NaN (0 * inf on a slab boundary) keeps the old bound.
+            t_min = t0 > t_min ? t0 : t_min;
+            t_max = t1 < t_max ? t1 : t_max;
+            if (t_max < t_min) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    /**
+     * Packet version of the slab test, returns the mask of the active lanes
+     * that overlap the box within [0, t_max[lane]]. Interval arithmetic over
+     * the shared origin first rejects boxes the whole packet misses.
+     */
+    unsigned intersect(RayPacket const &packet, double const *t_max) const {
+        double far = 0;
+        for (int lane = 0; lane < RayPacket::SIZE; ++lane) {
+            far = (packet.active & (1U << lane)) && t_max[lane] > far ? t_max[lane] : far;
+        }
+        double entry = 0, exit = far;
+        for (int axis = 0; axis < 3; ++axis) {
+            if (!packet.cullable[axis]) {
+                continue;
+            }
+            double near_plane = min.data[axis] - packet.O.data[axis],
+                    far_plane = max.data[axis] - packet.O.data[axis];
+            if (packet.inv_lo[axis] < 0) {
+                std::swap(near_plane, far_plane);
+            }
+            double near_lo = near_plane * packet.inv_lo[axis], near_hi = near_plane * packet.inv_hi[axis],
+                    far_lo = far_plane * packet.inv_lo[axis], far_hi = far_plane * packet.inv_hi[axis];
+            double earliest = near_lo < near_hi ? near_lo : near_hi,
+                    latest = far_lo > far_hi ? far_lo : far_hi;
+            entry = earliest > entry ? earliest : entry;
+            exit = latest < exit ? latest : exit;
+        }
+        if (entry > exit) {
+            return 0;
+        }
+
+        // Per lane slab test, axis by axis so that the lane loops vectorize
+        double lane_min[RayPacket::SIZE], lane_max[RayPacket::SIZE];
+        for (int lane = 0; lane < RayPacket::SIZE; ++lane) {
+            lane_min[lane] = 0;
+            lane_max[lane] = t_max[lane];
+        }
+        double const *inv_dir[3] = {packet.inv_dx, packet.inv_dy, packet.inv_dz};
+        for (int axis = 0; axis < 3; ++axis) {
+            double near_plane = min.data[axis] - packet.O.data[axis],
+                    far_plane = max.data[axis] - packet.O.data[axis];
+            for (int lane = 0; lane < RayPacket::SIZE; ++lane) {
+                double inv = inv_dir[axis][lane];
+                double t0 = (inv < 0 ? far_plane : near_plane) * inv,
+                        t1 = (inv < 0 ? near_plane : far_plane) * inv;
+                lane_min[lane] = t0 > lane_min[lane] ? t0 : lane_min[lane];
+                lane_max[lane] = t1 < lane_max[lane] ? t1 : lane_max[lane];
+            }
+        }
+        unsigned mask = 0;
+        for (int lane = 0; lane < RayPacket::SIZE; ++lane) {
+            mask |= (lane_max[lane] >= lane_min[lane] ? 1U : 0U) << lane;
+        }
+        return mask & packet.active;
+    }
+};
+
+#endif
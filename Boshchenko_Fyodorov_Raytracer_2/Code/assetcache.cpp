@@ -0,0 +1,43 @@
+#include "assetcache.h"
+#include "mesh.h"
+#include "shapes/meshobject.h"
+
+using namespace std;
+
+shared_ptr<MeshObject const> AssetCache::mesh(string const &filename, PhaseTimes &times) {
+    FileStamp stamp;
+    if (!FileStamp::read(filename, stamp)) {
+        // Let Mesh report the missing file, and do not keep a stale copy
+        meshes.erase(filename);
+        ScopedTimer timer(times.mesh_load);
+        return make_shared<MeshObject const>(Mesh(filename));
+    }
+    auto found = meshes.find(filename);
+    if (found != meshes.end() && found->second.stamp == stamp) {
+        ++counts.hits;
+        return found->second.mesh;
+    }
+    ++counts.misses;
+    unique_ptr<Mesh> mesh;
+    {
+        ScopedTimer timer(times.mesh_load);
+        mesh.reset(new Mesh(filename));
+    }
+    ScopedTimer timer(times.accel_build);
+    Entry &entry = meshes[filename];
+    entry.mesh = make_shared<MeshObject const>(*mesh);
+    entry.stamp = stamp;
+    return entry.mesh;
+}
+
+TexturePtr AssetCache::texture(string const &filename, PhaseTimes &times) {
+    ScopedTimer timer(times.texture_decode);
+    bool loaded = false;
+    TexturePtr texture = TextureCache::instance().get(filename, &loaded);
+    ++(loaded ? counts.misses : counts.hits);
+    return texture;
+}
+
+AssetCache::Counts const &AssetCache::getCounts() const {
+    return counts;
+}
@@ -0,0 +1,48 @@
+#ifndef ASSETCACHE_H_
+#define ASSETCACHE_H_
+
+#include "filestamp.h"
+#include "stats.h"
+#include "texturecache.h"
+
+#include <map>
+#include <memory>
+#include <string>
+
+class MeshObject;
+
+/**
+ * Meshes (with their BVH) that outlive a scene, for a process that renders
+ * one job after another. Entries are keyed by file path and remember the
+ * modification time and size of the file; a file that changed on disk is
+ * loaded again on its next use. Textures are kept the same way by the
+ * process-wide TextureCache, this class only counts them. Not thread safe,
+ * scenes are read one at a time.
+ */
+class AssetCache {
+public:
+    struct Counts {
+        unsigned hits = 0;
+        unsigned misses = 0;
+    };
+
+    // The mesh of an OBJ file, ready to be copied into a scene; the loading
+    // and BVH building of a miss are added to times
+    std::shared_ptr<MeshObject const> mesh(std::string const &filename, PhaseTimes &times);
+
+    // A decoded PNG texture from the TextureCache; the decoding is added to times
+    TexturePtr texture(std::string const &filename, PhaseTimes &times);
+
+    Counts const &getCounts() const;
+
+private:
+    struct Entry {
+        FileStamp stamp;
+        std::shared_ptr<MeshObject const> mesh;
+    };
+
+    std::map<std::string, Entry> meshes;
+    Counts counts;
+};
+
+#endif
@@ -0,0 +1,137 @@
+#include "batch.h"
+#include "image.h"
+#include "raytracer.h"
+
+#include "json/json.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <future>
+#include <iostream>
+#include <regex>
+#include <set>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+using namespace std;
+using json = nlohmann::json;
+
+namespace {
+
+json readJson(string const &filename) {
+    ifstream infile(filename);
+    if (!infile) throw runtime_error("Could not open " + filename + " for reading.");
+    return json::parse(infile);
+}
+
+// Sets the parameters in overrides on the elements of list with the same
+// index. A frame may only change parameters the element already has and add
+// those in 'added', so that e.g. a "rotate" is not silently ignored.
+void mergeByIndex(json &list, json const &overrides, string const &name, set<string> const &added) {
+    auto merge = [&](size_t index, json const &changes) {
+        if (changes.is_null()) {
+            return;
+        }
+        if (!list.is_array() || index >= list.size() || !changes.is_object()) {
+            throw runtime_error("Frame overrides " + name + " " + to_string(index) + ", which does not exist.");
+        }
+        json &element = list[index];
+        for (auto change = changes.begin(); change != changes.end(); ++change) {
+            if (element.find(change.key()) == element.end() && added.count(change.key()) == 0) {
+                throw runtime_error("Frame sets \"" + change.key() + "\" of " + name + " " + to_string(index) +
+                                    ", which is not one of its parameters.");
+            }
+            element[change.key()] = change.value();
+        }
+    };
+    if (overrides.is_array()) {
+        for (size_t index = 0; index < overrides.size(); ++index) {
+            merge(index, overrides[index]);
+        }
+    } else if (overrides.is_object()) {
+        for (auto entry = overrides.begin(); entry != overrides.end(); ++entry) {
+            merge(stoul(entry.key()), entry.value());
+        }
+    } else {
+        throw runtime_error("The " + name + " of a frame must be an array or an object.");
+    }
+}
+
+}
+
+BatchRenderer::BatchRenderer(int threads)
+        :
+        threads(threads) {}
+
+bool BatchRenderer::run(string const &scene_file, string const &frames_file, string const &output)
+try {
+    if (!regex_match(output, regex("[^%]*%[0-9]*d[^%]*"))) {
+        throw runtime_error("The output needs one %d (or %04d, ...) for the frame number.");
+    }
+    json scene = readJson(scene_file);
+    json frames = readJson(frames_file);
+    if (!frames.is_array()) throw runtime_error("The frames file must hold an array of overrides.");
+    if (threads >= 0) {
+        scene["Threads"] = threads;
+    }
+
+    // All frames are merged first, so that a mistake in a late one fails before anything is rendered
+    vector<json> merged;
+    for (size_t index = 0; index < frames.size(); ++index) {
+        json frame = scene;
+        json const &overrides = frames[index];
+        if (!overrides.is_object()) throw runtime_error("Frame " + to_string(index) + " is not a json object.");
+        for (auto entry = overrides.begin(); entry != overrides.end(); ++entry) {
+            if (entry.key() == "Lights") {
+                mergeByIndex(frame["Lights"], entry.value(), "Lights", {});
+            } else if (entry.key() == "Objects") {
+                // "translate" is the only transform an object takes
+                mergeByIndex(frame["Objects"], entry.value(), "Objects", {"translate"});
+            } else {
+                frame[entry.key()] = entry.value();
+            }
+        }
+        merged.push_back(move(frame));
+    }
+
+    Stopwatch watch;
+    future<void> encoding;      // of the frame before
+    for (size_t index = 0; index < merged.size(); ++index) {
+        vector<char> name(output.size() + 32);
+        snprintf(name.data(), name.size(), output.c_str(), static_cast<int>(index));
+        cout << "Frame " << index + 1 << " of " << frames.size() << ": " << name.data() << '\n';
+
+        // Meshes without a material get a random color, the same in every frame
+        srandom(1);
+        Raytracer raytracer;
+        raytracer.setAssetCache(&assets);
+        Image img;
+        if (!raytracer.readSceneJson(merged[index]) || !raytracer.renderImage(img)) {
+            throw runtime_error("Frame " + to_string(index) + " failed.");
+        }
+
+        // Encode this frame while the next one is traced, one at a time
+        if (encoding.valid()) {
+            encoding.get();
+        }
+        encoding = async(launch::async, [](Image const &img, string const &filename) {
+            img.write_png(filename);
+        }, move(img), string(name.data()));
+    }
+    if (encoding.valid()) {
+        encoding.get();
+    }
+
+    double seconds = watch.seconds();
+    AssetCache::Counts const &counts = assets.getCounts();
+    cout << "Rendered " << frames.size() << " frames in " << seconds << " s ("
+         << (frames.empty() ? 0.0 : seconds / frames.size()) << " s per frame); "
+         << counts.misses << " meshes and textures loaded, " << counts.hits << " reused.\n";
+    return true;
+}
+catch (exception const &ex) {
+    cerr << ex.what() << '\n';
+    return false;
+}
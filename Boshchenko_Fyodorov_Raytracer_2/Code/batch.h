@@ -0,0 +1,42 @@
+#ifndef BATCH_H_
+#define BATCH_H_
+
+#include "assetcache.h"
+
+#include <string>
+
+/**
+ * Renders a sequence of frames of one scene in a single process, e.g. a
+ * turntable or a camera path. The frames file is a json array with the
+ * overrides of every frame:
+ *
+ *   [{"Eye": [200, 200, 1000]},
+ *    {"Eye": [210, 200, 995], "Lights": [{"position": [600, 600, 1500]}],
+ *     "Objects": {"2": {"translate": [0, 5, 0]}}}]
+ *
+ * "Lights" and "Objects" change the parameters of the light or object with
+ * the same index in the scene file: an array (null leaves one unchanged)
+ * or an object keyed by index. They can only change parameters the scene
+ * file gives, plus the optional "translate": [x, y, z] of an object, which
+ * moves it as a whole; there is no rotation or scale, and any other key is
+ * an error. Every other key of a frame replaces the scene parameter of the
+ * same name. A frame starts from the scene file, not from the frame
+ * before. Meshes with their BVHs and textures are loaded once (AssetCache),
+ * and the PNG of a frame is encoded on another thread while the next frame
+ * is traced.
+ */
+class BatchRenderer {
+public:
+    // threads >= 0 overrides the "Threads" of the scene
+    explicit BatchRenderer(int threads = -1);
+
+    // output is a printf pattern for the frame number, e.g. "frame%04d.png";
+    // returns false if a file cannot be read or a frame fails
+    bool run(std::string const &scene_file, std::string const &frames_file, std::string const &output);
+
+private:
+    AssetCache assets;
+    int threads;
+};
+
+#endif
@@ -0,0 +1,183 @@
+#include "bvh.h"
+
+#include <algorithm>
+#include <numeric>
+
+using namespace std;
+
+void BVH::build(vector<AABB> const &bounds, unsigned max_leaf_size, double intersection_cost) {
+    this->max_leaf_size = max_leaf_size;
+    this->intersection_cost = intersection_cost;
+    nodes.clear();
+    prim_order.resize(bounds.size());
+    iota(prim_order.begin(), prim_order.end(), 0U);
+    if (bounds.empty()) {
+        return;
+    }
+
+    vector<Point> centroids;
+    centroids.reserve(bounds.size());
+    for (AABB const &box : bounds) {
+        centroids.push_back(box.centroid());
+    }
+
+    nodes.reserve(2 * bounds.size());
+    buildNode(bounds, centroids, 0, static_cast<unsigned>(bounds.size()), 0);
+}
+
+bool BVH::assign(vector<Node> tree, vector<unsigned> order) {
+    nodes.clear();
+    prim_order.clear();
+    vector<bool> seen(order.size());
+    for (unsigned prim : order) {
+        if (prim >= order.size() || seen[prim]) {
+            return false;
+        }
+        seen[prim] = true;
+    }
+    if (tree.empty() != order.empty()) {
+        return false;
+    }
+
+    // Walked like build() stores it, left child first: every node is reached
+    // once, no deeper than a traversal stack allows, and the leaves follow
+    // each other through order
+    vector<pair<unsigned, int>> stack;
+    if (!tree.empty()) {
+        stack.emplace_back(0, 0);
+    }
+    size_t visited = 0;
+    unsigned position = 0;
+    while (!stack.empty()) {
+        unsigned index = stack.back().first;
+        int depth = stack.back().second;
+        stack.pop_back();
+        Node const &node = tree[index];
+        if (++visited > tree.size()) {
+            return false;   // a node reached twice
+        }
+        if (node.count > 0) {
+            if (node.first != position || node.count > order.size() - position) {
+                return false;
+            }
+            position += node.count;
+        } else {
+            if (depth >= MAX_DEPTH || node.first <= index + 1 || node.first >= tree.size() || node.axis < 0 ||
+                node.axis > 2) {
+                return false;
+            }
+            stack.emplace_back(node.first, depth + 1);
+            stack.emplace_back(index + 1, depth + 1);
+        }
+    }
+    if (visited != tree.size() || position != order.size()) {
+        return false;
+    }
+    nodes = move(tree);
+    prim_order = move(order);
+    return true;
+}
+
+vector<unsigned> const &BVH::order() const {
+    return prim_order;
+}
+
+vector<BVH::Node> const &BVH::getNodes() const {
+    return nodes;
+}
+
+bool BVH::empty() const {
+    return nodes.empty();
+}
+
+unsigned BVH::buildNode(vector<AABB> const &bounds, vector<Point> const &centroids,
+                        unsigned begin, unsigned end, int depth) {
+    // Nodes are stored depth-first: the left child directly follows its parent.
+    unsigned index = static_cast<unsigned>(nodes.size());
+    nodes.push_back(Node());
+
+    AABB box, centroid_box;
+    for (unsigned i = begin; i < end; ++i) {
+        box.extend(bounds[prim_order[i]]);
+        centroid_box.extend(centroids[prim_order[i]]);
+    }
+    nodes[index].box = box;
+
+    unsigned count = end - begin;
+    int axis = centroid_box.longestAxis();
+    double axis_min = centroid_box.min.data[axis],
+            extent = centroid_box.max.data[axis] - axis_min;
+    if (count == 1 || depth >= MAX_DEPTH || extent <= 0) {
+        // Nothing to split: a single primitive, or all centroids coincide.
+        makeLeaf(index, begin, end);
+        return index;
+    }
+
+    // Bin the primitives by centroid along the longest axis
+    auto binOf = [&](unsigned prim) {
+        int bin = static_cast<int>(BIN_COUNT * (centroids[prim].data[axis] - axis_min) / extent);
+        return min(bin, BIN_COUNT - 1);
+    };
+    AABB bin_boxes[BIN_COUNT];
+    unsigned bin_counts[BIN_COUNT] = {};
+    for (unsigned i = begin; i < end; ++i) {
+        int bin = binOf(prim_order[i]);
+        bin_boxes[bin].extend(bounds[prim_order[i]]);
+        ++bin_counts[bin];
+    }
+
+    // Sweep from the right to get the area and count on the right of every split
+    double right_area[BIN_COUNT];
+    unsigned right_count[BIN_COUNT];
+    AABB right_box;
+    unsigned right_total = 0;
+    for (int bin = BIN_COUNT - 1; bin > 0; --bin) {
+        right_box.extend(bin_boxes[bin]);
+        right_total += bin_counts[bin];
+        right_area[bin] = right_box.surfaceArea();
+        right_count[bin] = right_total;
+    }
+
+    // Sweep from the left and evaluate the SAH for a split in front of every bin
+    double parent_area = box.surfaceArea();
+    double best_cost = numeric_limits<double>::infinity();
+    int best_split = -1;
+    AABB left_box;
+    unsigned left_total = 0;
+    for (int split = 1; split < BIN_COUNT; ++split) {
+        left_box.extend(bin_boxes[split - 1]);
+        left_total += bin_counts[split - 1];
+        if (left_total == 0 || right_count[split] == 0) {
+            continue;
+        }
+        double cost = TRAVERSAL_COST + intersection_cost *
+                      (left_box.surfaceArea() * left_total + right_area[split] * right_count[split]) / parent_area;
+        if (cost < best_cost) {
+            best_cost = cost;
+            best_split = split;
+        }
+    }
+
+    if (best_split < 0 || (best_cost >= count * intersection_cost && count <= max_leaf_size)) {
+        // Splitting does not pay off
+        makeLeaf(index, begin, end);
+        return index;
+    }
+
+    auto mid_iter = partition(prim_order.begin() + begin, prim_order.begin() + end,
+                              [&](unsigned prim) { return binOf(prim) < best_split; });
+    auto mid = static_cast<unsigned>(mid_iter - prim_order.begin());
+
+    buildNode(bounds, centroids, begin, mid, depth + 1);
+    unsigned right = buildNode(bounds, centroids, mid, end, depth + 1);
+    nodes[index].first = right;
+    nodes[index].count = 0;
+    nodes[index].axis = axis;
+    return index;
+}
+
+void BVH::makeLeaf(unsigned index, unsigned begin, unsigned end) {
+    nodes[index].first = begin;
+    nodes[index].count = end - begin;
+    nodes[index].axis = 0;
+}
@@ -0,0 +1,207 @@
+#ifndef BVH_H_
+#define BVH_H_
+
+#include "aabb.h"
+#include "ray.h"
+#include "raypacket.h"
+#include "stats.h"
+
+#include <vector>
+
+/**
+ * Bounding volume hierarchy built with the surface area heuristic.
+ *
+ * The BVH only knows about boxes: build() receives one AABB per primitive and
+ * reorders primitive indices so that every leaf covers a contiguous range of
+ * order(). Callers keep their primitives in that same order and receive
+ * positions into it from intersect(), so the hierarchy can be shared by any
+ * kind of primitive (scene objects, mesh triangles, ...).
+ */
+class BVH {
+public:
+    struct Node {
+        AABB box;
+        unsigned first;     // leaf: first position in order(); inner: index of the right child
+        unsigned count;     // number of primitives in a leaf, 0 for inner nodes
+        int axis;           // split axis of an inner node, used for front-to-back traversal
+    };
+
+    /**
+     * intersection_cost is the cost of testing one primitive relative to
+     * visiting a node; leaves hold at most max_leaf_size primitives unless
+     * their centroids cannot be separated.
+     */
+    void build(std::vector<AABB> const &bounds, unsigned max_leaf_size = 4, double intersection_cost = 1.0);
+
+    /**
+     * Takes a hierarchy that build() made before, e.g. one read from a file,
+     * with order() as 'order'. Returns false and stays empty unless the
+     * nodes form such a tree over all positions of order, which must be a
+     * permutation; the boxes are not checked.
+     */
+    bool assign(std::vector<Node> nodes, std::vector<unsigned> order);
+
+    // Primitive indices (as passed to build) in leaf order
+    std::vector<unsigned> const &order() const;
+
+    std::vector<Node> const &getNodes() const;
+
+    bool empty() const;
+
+    /**
+     * Visits every leaf whose box overlaps the ray within [0, t_max], nearest
+     * subtree first. For each primitive in such a leaf leaf(position, t_max)
+     * is called; it may shrink t_max when it finds a closer hit, which prunes
+     * the remaining traversal.
+     */
+    template<typename LeafFn>
+    void intersect(Ray const &ray, double &t_max, LeafFn &&leaf) const;
+
+    // Same traversal, but leaf(first, count, t_max) is called once per leaf
+    template<typename LeafFn>
+    void traverse(Ray const &ray, double &t_max, LeafFn &&leaf) const;
+
+    /**
+     * Any-hit traversal for occlusion queries: leaf(first, count) is called
+     * for every leaf whose box overlaps the ray within [0, t_max] and the
+     * traversal stops as soon as it returns true. No order is imposed.
+     */
+    template<typename LeafFn>
+    bool traverseAny(Ray const &ray, double t_max, LeafFn &&leaf) const;
+
+    /**
+     * Shared traversal for a packet: a node is visited when any lane overlaps
+     * it within [0, t_max[lane]], and leaf(first, count, lanes) receives the
+     * mask of those lanes. t_max is read on every visit, so the leaf function
+     * may shrink it per lane.
+     */
+    template<typename LeafFn>
+    void traversePacket(RayPacket const &packet, double const *t_max, LeafFn &&leaf) const;
+
+private:
+    static int constexpr BIN_COUNT = 16;
+    static int constexpr MAX_DEPTH = 64;
+    static double constexpr TRAVERSAL_COST = 1.0;
+
+    unsigned max_leaf_size = 4;
+    double intersection_cost = 1.0;
+    std::vector<Node> nodes;
+    std::vector<unsigned> prim_order;
+
+    unsigned buildNode(std::vector<AABB> const &bounds, std::vector<Point> const &centroids,
+                       unsigned begin, unsigned end, int depth);
+
+    void makeLeaf(unsigned index, unsigned begin, unsigned end);
+};
+
+template<typename LeafFn>
+void BVH::intersect(Ray const &ray, double &t_max, LeafFn &&leaf) const {
+    traverse(ray, t_max, [&leaf](unsigned first, unsigned count, double &t_max) {
+        for (unsigned pos = first; pos < first + count; ++pos) {
+            leaf(pos, t_max);
+        }
+    });
+}
+
+template<typename LeafFn>
+void BVH::traverse(Ray const &ray, double &t_max, LeafFn &&leaf) const {
+    if (nodes.empty()) {
+        return;
+    }
+    Vector inv_dir(1.0 / ray.D.x, 1.0 / ray.D.y, 1.0 / ray.D.z);
+
+    unsigned stack[MAX_DEPTH + 2];
+    int top = 0;
+    stack[top++] = 0;
+    uint64_t visited = 0;
+    while (top > 0) {
+        unsigned index = stack[--top];
+        Node const &node = nodes[index];
+        ++visited;
+        if (!node.box.intersect(ray, inv_dir, 0, t_max)) {
+            continue;
+        }
+        if (node.count > 0) {
+            leaf(node.first, node.count, t_max);
+        } else if (ray.D.data[node.axis] < 0) {
+            // The right child lies nearer, so it is popped first.
+            stack[top++] = index + 1;
+            stack[top++] = node.first;
+        } else {
+            stack[top++] = node.first;
+            stack[top++] = index + 1;
+        }
+    }
+    threadCounters().bvh_nodes += visited;
+}
+
+template<typename LeafFn>
+bool BVH::traverseAny(Ray const &ray, double t_max, LeafFn &&leaf) const {
+    if (nodes.empty()) {
+        return false;
+    }
+    Vector inv_dir(1.0 / ray.D.x, 1.0 / ray.D.y, 1.0 / ray.D.z);
+
+    unsigned stack[MAX_DEPTH + 2];
+    int top = 0;
+    stack[top++] = 0;
+    uint64_t visited = 0;
+    while (top > 0) {
+        unsigned index = stack[--top];
+        Node const &node = nodes[index];
+        ++visited;
+        if (!node.box.intersect(ray, inv_dir, 0, t_max)) {
+            continue;
+        }
+        if (node.count > 0) {
+            if (leaf(node.first, node.count)) {
+                threadCounters().bvh_nodes += visited;
+                return true;
+            }
+        } else {
+            stack[top++] = node.first;
+            stack[top++] = index + 1;
+        }
+    }
+    threadCounters().bvh_nodes += visited;
+    return false;
+}
+
+template<typename LeafFn>
+void BVH::traversePacket(RayPacket const &packet, double const *t_max, LeafFn &&leaf) const {
+    if (nodes.empty() || !packet.active) {
+        return;
+    }
+    // Children are ordered by the direction of the first active lane
+    int lane = 0;
+    while (!(packet.active & (1U << lane))) {
+        ++lane;
+    }
+    double const direction[3] = {packet.dx[lane], packet.dy[lane], packet.dz[lane]};
+
+    unsigned stack[MAX_DEPTH + 2];
+    int top = 0;
+    stack[top++] = 0;
+    uint64_t visited = 0;
+    while (top > 0) {
+        unsigned index = stack[--top];
+        Node const &node = nodes[index];
+        ++visited;
+        unsigned lanes = node.box.intersect(packet, t_max);
+        if (!lanes) {
+            continue;
+        }
+        if (node.count > 0) {
+            leaf(node.first, node.count, lanes);
+        } else if (direction[node.axis] < 0) {
+            stack[top++] = index + 1;
+            stack[top++] = node.first;
+        } else {
+            stack[top++] = node.first;
+            stack[top++] = index + 1;
+        }
+    }
+    threadCounters().bvh_nodes += visited;
+}
+
+#endif
@@ -0,0 +1,166 @@
+#include "checkpoint.h"
+
+#include <unistd.h>
+
+#include <cstring>
+#include <iostream>
+
+using namespace std;
+
+namespace {
+
+char const MAGIC[8] = {'R', 'A', 'Y', 'C', 'K', 'P', 'T', '\n'};
+uint32_t const VERSION = 2;
+
+struct Header {
+    char magic[8];
+    uint32_t version;
+    uint32_t region[4];     // x0, y0, x1, y1
+    uint32_t channel_size;  // bytes per color channel of the records
+    uint64_t config;
+};
+
+size_t const BUFFER_SIZE = 1 << 20;
+
+}
+
+Checkpoint::~Checkpoint() {
+    if (file) {
+        fclose(file);
+    }
+}
+
+bool Checkpoint::open(string const &filename, uint64_t config, Tile const &region, bool resume, double interval) {
+    this->filename = filename;
+    this->region = region;
+    this->interval = interval;
+    records.clear();
+    restored_tiles.clear();
+
+    long good_size = 0;
+    if (resume && readExisting(config, good_size)) {
+        // Continue after the last complete record
+        file = fopen(filename.c_str(), "r+b");
+        if (!file || ftruncate(fileno(file), good_size) != 0 || fseek(file, good_size, SEEK_SET) != 0) {
+            return false;
+        }
+    } else {
+        records.clear();
+        restored_tiles.clear();
+        file = fopen(filename.c_str(), "wb");
+        if (!file) {
+            return false;
+        }
+        Header header;
+        memset(&header, 0, sizeof header);  // no stray bytes in the file
+        memcpy(header.magic, MAGIC, sizeof MAGIC);
+        header.version = VERSION;
+        header.region[0] = region.x0;
+        header.region[1] = region.y0;
+        header.region[2] = region.x1;
+        header.region[3] = region.y1;
+        header.channel_size = sizeof(PixelChannel);
+        header.config = config;
+        if (fwrite(&header, sizeof header, 1, file) != 1 || fflush(file) != 0) {
+            return false;
+        }
+    }
+    buffer.resize(BUFFER_SIZE);
+    setvbuf(file, buffer.data(), _IOFBF, buffer.size());
+    since_flush = Stopwatch();
+    return true;
+}
+
+bool Checkpoint::readExisting(uint64_t config, long &good_size) {
+    FILE *in = fopen(filename.c_str(), "rb");
+    if (!in) {
+        return false;
+    }
+    Header header;
+    memset(&header, 0, sizeof header);
+    bool matches = fread(&header, sizeof header, 1, in) == 1 && memcmp(header.magic, MAGIC, sizeof MAGIC) == 0 &&
+                   header.version == VERSION && header.config == config &&
+                   header.region[0] == region.x0 && header.region[1] == region.y0 &&
+                   header.region[2] == region.x1 && header.region[3] == region.y1 &&
+                   header.channel_size == sizeof(PixelChannel);
+    good_size = static_cast<long>(sizeof header);
+    while (matches) {
+        uint32_t rect[4];
+        if (fread(rect, sizeof rect, 1, in) != 1) {
+            break;
+        }
+        Record record;
+        record.tile = Tile{rect[0], rect[1], rect[2], rect[3]};
+        Tile const &t = record.tile;
+        if (t.x0 < region.x0 || t.y0 < region.y0 || t.x1 > region.x1 || t.y1 > region.y1 ||
+            t.x0 >= t.x1 || t.y0 >= t.y1) {
+            break;
+        }
+        record.rgb.resize(3 * size_t(t.x1 - t.x0) * (t.y1 - t.y0));
+        if (fread(record.rgb.data(), sizeof(PixelChannel), record.rgb.size(), in) != record.rgb.size()) {
+            break;
+        }
+        good_size = ftell(in);
+        restored_tiles.insert(make_pair(t.x0, t.y0));
+        records.push_back(move(record));
+    }
+    fclose(in);
+    return matches;
+}
+
+size_t Checkpoint::numRestored() const {
+    return records.size();
+}
+
+bool Checkpoint::restored(Tile const &tile) const {
+    return restored_tiles.count(make_pair(tile.x0, tile.y0)) > 0;
+}
+
+void Checkpoint::restore(Image &img) const {
+    for (Record const &record : records) {
+        PixelChannel const *rgb = record.rgb.data();
+        for (unsigned y = record.tile.y0; y < record.tile.y1; ++y) {
+            for (unsigned x = record.tile.x0; x < record.tile.x1; ++x, rgb += 3) {
+                img(x - region.x0, y - region.y0) = Pixel(rgb[0], rgb[1], rgb[2]);
+            }
+        }
+    }
+}
+
+void Checkpoint::add(Tile const &tile, Image const &img) {
+    // Copy the pixels out before taking the lock
+    vector<PixelChannel> rgb;
+    rgb.reserve(3 * size_t(tile.x1 - tile.x0) * (tile.y1 - tile.y0));
+    for (unsigned y = tile.y0; y < tile.y1; ++y) {
+        for (unsigned x = tile.x0; x < tile.x1; ++x) {
+            Pixel const &pixel = img(x - region.x0, y - region.y0);
+            rgb.insert(rgb.end(), {pixel.r, pixel.g, pixel.b});
+        }
+    }
+    uint32_t rect[4] = {tile.x0, tile.y0, tile.x1, tile.y1};
+
+    lock_guard<std::mutex> lock(mutex);
+    if (!file) {
+        return;
+    }
+    bool ok = fwrite(rect, sizeof rect, 1, file) == 1 &&
+              fwrite(rgb.data(), sizeof(PixelChannel), rgb.size(), file) == rgb.size();
+    if (ok && since_flush.seconds() >= interval) {
+        ok = fflush(file) == 0;
+        since_flush = Stopwatch();
+    }
+    if (!ok) {
+        // E.g. a full disk: the tiles so far stay usable, a record cut short is dropped on resume
+        cerr << "Error: could not write the checkpoint " << filename << ", checkpointing stopped.\n";
+        fclose(file);
+        file = nullptr;
+    }
+}
+
+void Checkpoint::finish() {
+    if (file) {
+        fclose(file);
+        file = nullptr;
+        remove(filename.c_str());
+    }
+}
@@ -0,0 +1,80 @@
+#ifndef CHECKPOINT_H_
+#define CHECKPOINT_H_
+
+#include "image.h"
+#include "stats.h"
+#include "tilequeue.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+/**
+ * Append-only log of the finished tiles of a render, so that a killed job
+ * can be resumed. The file starts with a header (magic, version, a hash of
+ * the render configuration and the region of the frame) followed by one
+ * record per tile: its rectangle in frame coordinates and its pixels as
+ * RGB in the precision of Pixel, row by row. Records are only ever appended through a large
+ * stdio buffer that is flushed every 'interval' seconds, so checkpointing
+ * costs a sequential write and no seeks; a record cut short by a crash is
+ * dropped on resume.
+ */
+class Checkpoint {
+public:
+    Checkpoint() = default;
+
+    ~Checkpoint();
+
+    Checkpoint(Checkpoint const &) = delete;
+
+    Checkpoint &operator=(Checkpoint const &) = delete;
+
+    /**
+     * Opens the log for a render of 'region' with configuration hash
+     * 'config'. With resume the tiles of an existing log with the same
+     * header are kept and restored by restore(); otherwise, or when the
+     * header differs, the log starts over. Returns false if the file cannot
+     * be written.
+     */
+    bool open(std::string const &filename, uint64_t config, Tile const &region, bool resume, double interval);
+
+    // number of tiles taken over from the previous run
+    size_t numRestored() const;
+
+    // whether a tile (in frame coordinates) was taken over from the previous run
+    bool restored(Tile const &tile) const;
+
+    // writes the pixels of the restored tiles into img (which covers the region)
+    void restore(Image &img) const;
+
+    // Appends a finished tile, img covers the region; safe to call from several
+    // threads. After a failed write the log is closed and nothing more is added.
+    void add(Tile const &tile, Image const &img);
+
+    // Closes the log and deletes it, the render is complete
+    void finish();
+
+private:
+    struct Record {
+        Tile tile;
+        std::vector<PixelChannel> rgb;
+    };
+
+    std::string filename;
+    std::FILE *file = nullptr;
+    std::vector<char> buffer;       // stdio buffer of file
+    Tile region{0, 0, 0, 0};
+    double interval = 0;
+    Stopwatch since_flush;
+    std::mutex mutex;
+    std::vector<Record> records;    // taken over from the previous run
+    std::set<std::pair<unsigned, unsigned>> restored_tiles;
+
+    bool readExisting(uint64_t config, long &good_size);
+};
+
+#endif
@@ -0,0 +1,34 @@
+#ifndef FILESTAMP_H_
+#define FILESTAMP_H_
+
+#include <sys/stat.h>
+
+#include <cstdint>
+#include <string>
+
+// Modification time and size of a file, to notice that it changed on disk
+struct FileStamp {
+    int64_t mtime = 0;  // nanoseconds
+    int64_t size = -1;
+
+    bool operator==(FileStamp const &other) const {
+        return mtime == other.mtime && size == other.size;
+    }
+
+    bool operator!=(FileStamp const &other) const {
+        return !(*this == other);
+    }
+
+    // false if the file cannot be stat'ed
+    static bool read(std::string const &filename, FileStamp &stamp) {
+        struct stat info;
+        if (stat(filename.c_str(), &info) != 0) {
+            return false;
+        }
+        stamp.mtime = int64_t(info.st_mtim.tv_sec) * 1000000000 + info.st_mtim.tv_nsec;
+        stamp.size = info.st_size;
+        return true;
+    }
+};
+
+#endif
@@ -0,0 +1,18 @@
+#ifndef HASH_H_
+#define HASH_H_
+
+#include <cstddef>
+#include <cstdint>
+
+// 64-bit FNV-1a of size bytes, continuing from seed to hash several pieces
+inline uint64_t hashBytes(void const *data, size_t size, uint64_t seed = 14695981039346656037ULL) {
+    unsigned char const *bytes = static_cast<unsigned char const *>(data);
+    uint64_t h = seed;
+    for (size_t idx = 0; idx < size; ++idx) {
+        h ^= bytes[idx];
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+#endif
@@ -18,21 +18,21 @@ Image::Image(string const &filename) {
 
 // normal accessors
 void Image::put_pixel(unsigned x, unsigned y, Color const &c) {
-    (*this)(x, y) = c;
+    (*this)(x, y) = Pixel(c);
 }
 
 Color Image::get_pixel(unsigned x, unsigned y) const {
-    return (*this)(x, y);
+    return Color((*this)(x, y));
 }
 
 // Handier accessors
 // Usage: color = img(x,y);
 //        img(x,y) = color;
-Color const &Image::operator()(unsigned x, unsigned y) const {
+Pixel const &Image::operator()(unsigned x, unsigned y) const {
     return d_pixels.at(index(x, y));
 }
 
-Color &Image::operator()(unsigned x, unsigned y) {
+Pixel &Image::operator()(unsigned x, unsigned y) {
     return d_pixels.at(index(x, y));
 }
 
@@ -50,14 +50,14 @@ unsigned Image::size() const {
 
 // Normalized accessors, unsignederval is (0...1, 0...1)
 // usefull for texture access
-Color const &Image::colorAt(float x, float y) const {
-    return d_pixels.at(findex(x, y));
+Color Image::colorAt(float x, float y) const {
+    return Color(d_pixels.at(findex(x, y)));
 }
 
 void Image::write_png(std::string const &filename) const {
     vector<unsigned char> image;
     image.reserve(size() * 4);  // reserves size (less allocations)
-    for (Color pixel : d_pixels) {
+    for (Pixel const &pixel : d_pixels) {
         image.push_back(static_cast<unsigned char>(pixel.r * 255.0));
         image.push_back(static_cast<unsigned char>(pixel.g * 255.0));
         image.push_back(static_cast<unsigned char>(pixel.b * 255.0));
@@ -84,6 +84,6 @@ void Image::read_png(std::string const &filename) {
         ++imgIter;
         // Ignore Alpha
         ++imgIter;
-        d_pixels.push_back(Color(r, g, b));
+        d_pixels.push_back(Pixel(r, g, b));
     }
 }
@@ -6,8 +6,19 @@
 #include <string>
 #include <vector>
 
+// The pixels of an Image. The RAY_FLOAT_PIXELS build option stores them in
+// single precision, in 16 instead of 24 bytes; every color is then rounded to
+// float before it is written, so a few pixels of a PNG move by one level.
+#ifdef RAY_FLOAT_PIXELS
+typedef Colorf Pixel;
+typedef float PixelChannel;
+#else
+typedef Color Pixel;
+typedef double PixelChannel;
+#endif
+
 class Image {
-    std::vector<Color> d_pixels;
+    std::vector<Pixel> d_pixels;
     unsigned d_width;
     unsigned d_height;
 
@@ -24,9 +35,9 @@ public:
     // Handier accessors
     // Usage: color = img(x,y);
     //        img(x,y) = color;
-    Color const &operator()(unsigned x, unsigned y) const;
+    Pixel const &operator()(unsigned x, unsigned y) const;
 
-    Color &operator()(unsigned x, unsigned y);
+    Pixel &operator()(unsigned x, unsigned y);
 
     unsigned width() const;
 
@@ -36,7 +47,7 @@ public:
 
     // Normalized accessors, unsignederval is (0...1, 0...1)
     // usefull for texture access
-    Color const &colorAt(float x, float y) const;
+    Color colorAt(float x, float y) const;
 
     void write_png(std::string const &filename) const;
 
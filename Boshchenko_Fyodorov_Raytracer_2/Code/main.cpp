@@ -1,37 +1,202 @@
+#include "batch.h"
+#include "mesh.h"
 #include "raytracer.h"
+#include "server.h"
+#include "texturecache.h"
 
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
 #include <iostream>
+#include <string>
+#include <vector>
 
 using namespace std;
 
+namespace {
+
+// The whole argument as a number; false if it is not one, so that it ends in the usage text
+bool parseNumber(char const *text, int &value) {
+    char *end;
+    errno = 0;
+    long number = strtol(text, &end, 10);
+    if (end == text || *end != '\0' || errno == ERANGE || number < INT_MIN || number > INT_MAX) {
+        return false;
+    }
+    value = static_cast<int>(number);
+    return true;
+}
+
+bool parseNumber(char const *text, double &value) {
+    char *end;
+    errno = 0;
+    value = strtod(text, &end);
+    return end != text && *end == '\0' && errno != ERANGE && isfinite(value);
+}
+
+}
+
 int main(int argc, char *argv[]) {
-    cout << "Introduction to Computer Graphics - Raytracer\n\n";
+    // split the options from the file names
+    vector<string> files;
+    int threads = -1;
+    unsigned width = 0, height = 0;
+    Tile crop{0, 0, 0, 0};
+    bool has_crop = false, bad_option = false;
+    string stats_file;
+    double time_budget = -1, progress_interval = -1;
+    double checkpoint_interval = -1;
+    bool resume = false;
+    bool server = false, texel_sidecars = false, mesh_files = false;
+    Texture::Layout texture_layout = Texture::LINEAR;
+    string socket_path;
+    string frames_file;
+    for (int idx = 1; idx < argc; ++idx) {
+        string arg = argv[idx];
+        if ((arg == "-t" || arg == "--threads") && idx + 1 < argc) {
+            bad_option |= !parseNumber(argv[++idx], threads);
+        } else if ((arg == "-s" || arg == "--size") && idx + 1 < argc) {
+            bad_option |= sscanf(argv[++idx], "%ux%u", &width, &height) != 2 || width == 0 || height == 0;
+        } else if (arg == "--stats" && idx + 1 < argc) {
+            stats_file = argv[++idx];
+        } else if ((arg == "-b" || arg == "--time-budget") && idx + 1 < argc) {
+            bad_option |= !parseNumber(argv[++idx], time_budget) || time_budget < 0;
+        } else if (arg == "--checkpoint" && idx + 1 < argc) {
+            bad_option |= !parseNumber(argv[++idx], checkpoint_interval) || checkpoint_interval <= 0;
+        } else if (arg == "--resume") {
+            resume = true;
+        } else if (arg == "--frames" && idx + 1 < argc) {
+            frames_file = argv[++idx];
+        } else if (arg == "--texture-cache") {
+            texel_sidecars = true;
+        } else if (arg == "--mesh-cache") {
+            mesh_files = true;
+        } else if (arg == "--texture-layout" && idx + 1 < argc) {
+            bad_option |= !Texture::parseLayout(argv[++idx], texture_layout);
+        } else if (arg == "--server") {
+            server = true;
+        } else if (arg == "--socket" && idx + 1 < argc) {
+            server = true;
+            socket_path = argv[++idx];
+        } else if (arg == "--progress" && idx + 1 < argc) {
+            bad_option |= !parseNumber(argv[++idx], progress_interval) || progress_interval < 0;
+        } else if ((arg == "-c" || arg == "--crop") && idx + 1 < argc) {
+            has_crop = true;
+            bad_option |= sscanf(argv[++idx], "%u,%u,%u,%u", &crop.x0, &crop.y0, &crop.x1, &crop.y1) != 4;
+        } else {
+            files.push_back(arg);
+        }
+    }
 
-    if (argc < 2 || argc > 3) {
-        cerr << "Usage: " << argv[0] << "in-file [out-file.png]\n";
+    // The options of a single render; the jobs of a server and the frames of
+    // a batch carry their own (e.g. "Width", "Crop")
+    bool render_options = width > 0 || has_crop || !stats_file.empty() || time_budget >= 0 ||
+                          progress_interval >= 0 || checkpoint_interval > 0 || resume;
+    bad_option |= (server || !frames_file.empty()) && render_options;
+
+    if ((server ? !files.empty() : files.empty() || files.size() > 2) || threads < -1 || bad_option) {
+        cerr << "Usage: " << argv[0] << " [--threads n] [--size WxH] [--crop x0,y0,x1,y1]"
+             << " [--time-budget seconds] [--progress seconds] [--checkpoint seconds] [--resume]"
+             << " [--texture-cache] [--texture-layout linear|tiled] [--mesh-cache] [--stats stats.json]"
+             << " in-file [out-file.png]\n"
+             << "       " << argv[0] << " [--threads n] [--texture-cache] [--texture-layout linear|tiled]"
+             << " [--mesh-cache] --frames frames.json in-file [out-file%04d.png]\n"
+             << "       " << argv[0] << " [--threads n] [--texture-cache] [--texture-layout linear|tiled]"
+             << " [--mesh-cache] --server | --socket path\n";
         return 1;
     }
 
+    // Decoded textures go to <png>.texels and are mapped from there by later runs
+    TextureCache::instance().setSidecars(texel_sidecars);
+    TextureCache::instance().setLayout(texture_layout);
+
+    // Parsed meshes and their BVH go to <obj>.mesh, later runs map that instead
+    Mesh::setMeshFiles(mesh_files);
+
+    if (server) {
+        // Jobs are json lines, see server.h; meshes and textures stay loaded between them
+        RenderServer render_server(threads);
+        if (!socket_path.empty()) {
+            cout << "Introduction to Computer Graphics - Raytracer\n\n";
+            return render_server.serveSocket(socket_path) ? 0 : 1;
+        }
+        // stdout carries the replies, the progress messages go to stderr
+        ostream replies(cout.rdbuf());
+        streambuf *console = cout.rdbuf(cerr.rdbuf());
+        cout << "Introduction to Computer Graphics - Raytracer\n\n";
+        render_server.serve(cin, replies);
+        cout.rdbuf(console);
+        return 0;
+    }
+
+    cout << "Introduction to Computer Graphics - Raytracer\n\n";
+
+    if (!frames_file.empty()) {
+        // One scene, many frames, see batch.h; frame numbers go where the %d is
+        string pattern;
+        if (files.size() >= 2) {
+            pattern = files[1];
+        } else {
+            pattern = files[0];
+            pattern.erase(pattern.begin() + pattern.find_last_of('.'), pattern.end());
+            pattern += "%04d.png";
+        }
+        return BatchRenderer(threads).run(files[0], frames_file, pattern) ? 0 : 1;
+    }
+
     Raytracer raytracer;
 
     // read the scene
-    if (!raytracer.readScene(argv[1])) {
-        cerr << "Error: reading scene from " << argv[1] <<
+    if (!raytracer.readScene(files[0])) {
+        cerr << "Error: reading scene from " << files[0] <<
              " failed - no output generated.\n";
         return 1;
     }
 
+    // the command line wins over the scene file
+    if (threads >= 0) {
+        raytracer.setThreads(static_cast<unsigned>(threads));
+    }
+    if (width > 0) {
+        raytracer.setResolution(width, height);
+    }
+    if (has_crop) {
+        raytracer.setCrop(crop);
+    }
+    if (time_budget >= 0) {
+        raytracer.setTimeBudget(time_budget);
+    }
+    if (progress_interval >= 0) {
+        raytracer.setProgressInterval(progress_interval);
+    }
+    if (checkpoint_interval > 0 || resume) {
+        raytracer.setCheckpoint(max(checkpoint_interval, 0.0), resume);
+    }
+
     // determine output name
     string ofname;
-    if (argc >= 3) {
-        ofname = argv[2];   // use the provided name
+    if (files.size() >= 2) {
+        ofname = files[1];  // use the provided name
     } else {
-        ofname = argv[1];   // replace .json with .png
+        ofname = files[0];  // replace .json with .png
         ofname.erase(ofname.begin() + ofname.find_last_of('.'), ofname.end());
         ofname += ".png";
     }
 
-    raytracer.renderToFile(ofname);
+    if (!raytracer.renderToFile(ofname)) {
+        return 1;
+    }
+
+    if (!stats_file.empty()) {
+        if (!raytracer.getStats().writeJson(stats_file)) {
+            cerr << "Error: could not write the statistics to " << stats_file << ".\n";
+            return 1;
+        }
+        cout << "Statistics written to " << stats_file << ".\n";
+    }
 
     return 0;
 }
@@ -2,8 +2,10 @@
 #define MATERIAL_H_
 
 #include "triple.h"
-#include "image.h"
+#include "texturecache.h"
 #include <iostream>
+#include <memory>
+
 class Material {
 public:
     Color color;        // base color
@@ -11,14 +13,18 @@ public:
     double kd;          // makeDiffuse intensity
     double ks;          // specular intensity
     double n;           // exponent for specular highlight size
-    bool has_texture = false;
-    Image texture;
+    TexturePtr texture; // nullptr if the material has a solid color
 
     Material() = default;
 
     void setTexture(std::string const &png_file) {
-        has_texture = true;
-        texture = Image("../Scenes/" + png_file);
+        // Materials naming the same file share its texture
+        texture = TextureCache::instance().get(texturePath(png_file));
+    }
+
+    // the file a "texture" parameter refers to
+    static std::string texturePath(std::string const &png_file) {
+        return "../Scenes/" + png_file;
     }
 
     Material(Color const &color, double ka, double kd, double ks, double n)
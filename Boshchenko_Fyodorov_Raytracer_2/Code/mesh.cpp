@@ -1,41 +1,141 @@
-#include "shapes/triangle.h"
 #include "objloader.h"
+#include "filestamp.h"
+#include "hash.h"
 #include "mesh.h"
+#include "meshfile.h"
+#include "triangleblock.h"
 #include <fstream>
 #include <iostream>
+#include <stdexcept>
 
 #define OFFSET 300
 #define SCALEFAC 50
 
+namespace {
+
+// A leaf is tested a whole block at a time, so it may hold a block's worth of triangles
+unsigned const LEAF_SIZE = TriangleBlock::WIDTH;
+double const INTERSECTION_COST = 0.25;
+
+// Identifies the BVH buildBVH() makes, so that a mesh file from a build
+// with other parameters gets a new one
+uint64_t bvhKey() {
+    double const parameters[] = {OFFSET, SCALEFAC, LEAF_SIZE, INTERSECTION_COST, 1 /* version */};
+    return hashBytes(parameters, sizeof parameters);
+}
+
+}
+
+std::atomic<bool> Mesh::mesh_files(false);
+
 Mesh::Mesh(std::string const filename) {
+    FileStamp stamp;
+    if (!mesh_files || !FileStamp::read(filename, stamp)) {
+        setGeometry(OBJLoader(filename), filename);
+        return;
+    }
+
+    MeshFile file;
+    if (file.open(filename, stamp)) {
+        setGeometry(OBJLoader(file), filename);
+        if (file.header().bvh_key != bvhKey()) {
+            return;
+        }
+        MeshFile::Node const *nodes = file.data<MeshFile::Node>(MeshFile::BVH_NODES);
+        std::vector<BVH::Node> tree(file.count(MeshFile::BVH_NODES));
+        for (BVH::Node &node : tree) {
+            node.box = AABB(Point(nodes->min[0], nodes->min[1], nodes->min[2]),
+                            Point(nodes->max[0], nodes->max[1], nodes->max[2]));
+            node.first = nodes->first;
+            node.count = nodes->count;
+            node.axis = nodes->axis;
+            ++nodes;
+        }
+        uint32_t const *order = file.data<uint32_t>(MeshFile::BVH_ORDER);
+        auto loaded = std::make_shared<BVH>();
+        if (file.count(MeshFile::BVH_ORDER) == numTriangles() &&
+            loaded->assign(std::move(tree), std::vector<unsigned>(order, order + numTriangles()))) {
+            bvh = loaded;
+        }
+        return;
+    }
 
+    // Compile the mesh for the next run, with the BVH the MeshObject would build anyway
     OBJLoader obj(filename);
+    setGeometry(obj, filename);
+    auto built = std::make_shared<BVH>(buildBVH());
+    bvh = built;
+    MeshFile::Contents contents;
+    std::vector<uint32_t> face_indices;
+    if (!obj.meshFileContents(contents, face_indices)) {
+        return;
+    }
+    std::vector<MeshFile::Node> nodes;
+    nodes.reserve(built->getNodes().size());
+    for (BVH::Node const &node : built->getNodes()) {
+        nodes.push_back(MeshFile::Node{{node.box.min.x, node.box.min.y, node.box.min.z},
+                                       {node.box.max.x, node.box.max.y, node.box.max.z},
+                                       node.first, node.count, node.axis, 0});
+    }
+    contents.data[MeshFile::BVH_NODES] = nodes.data();
+    contents.count[MeshFile::BVH_NODES] = nodes.size();
+    contents.data[MeshFile::BVH_ORDER] = built->order().data();
+    contents.count[MeshFile::BVH_ORDER] = built->order().size();
+    contents.bvh_key = bvhKey();
+    MeshFile::write(filename, stamp, contents);
+}
+
+void Mesh::setGeometry(OBJLoader const &obj, std::string const &filename) {
+    std::vector<Vertex> data = obj.coordinate_data();
+    indices = obj.coordinate_indices();
+
+    //triangles share their corners, so every coordinate is placed once
+    vertices.reserve(data.size());
+    for (Vertex const &vertex : data) {
+        vertices.emplace_back(
+                SCALEFAC * vertex.x + OFFSET,
+                SCALEFAC * vertex.y + OFFSET,
+                SCALEFAC * vertex.z + OFFSET);
+    }
+
+    for (unsigned index : indices) {
+        if (index >= vertices.size()) {
+            throw std::runtime_error("Mesh(): face refers to a missing vertex in " + filename);
+        }
+    }
+}
+
+const std::vector<Pointf> &Mesh::getVertices() const {
+    return vertices;
+}
+
+const std::vector<unsigned> &Mesh::getIndices() const {
+    return indices;
+}
+
+unsigned Mesh::numTriangles() const {
+    return static_cast<unsigned>(indices.size() / 3);
+}
+
+const std::shared_ptr<BVH const> &Mesh::getBVH() const {
+    return bvh;
+}
 
-    std::vector<Vertex> data = obj.vertex_data();
-
-    //add a new triangle for every 3 points
-    for (unsigned long i = 0; i < data.size(); i += 3) {
-        Point a{
-                SCALEFAC * data.at(i).x + OFFSET,
-                SCALEFAC * data.at(i).y + OFFSET,
-                SCALEFAC * data.at(i).z + OFFSET,
-        };
-        Point b{
-                SCALEFAC * data.at(i + 1).x + OFFSET,
-                SCALEFAC * data.at(i + 1).y + OFFSET,
-                SCALEFAC * data.at(i + 1).z + OFFSET,
-        };
-        Point c{
-                SCALEFAC * data.at(i + 2).x + OFFSET,
-                SCALEFAC * data.at(i + 2).y + OFFSET,
-                SCALEFAC * data.at(i + 2).z + OFFSET,
-        };
-
-        Triangle triangle(a, b, c);
-        triangles.push_back(triangle);
+BVH Mesh::buildBVH() const {
+    std::vector<AABB> bounds;
+    bounds.reserve(numTriangles());
+    for (size_t i = 0; i + 2 < indices.size(); i += 3) {
+        AABB box;
+        box.extend(Point(vertices[indices[i]]));
+        box.extend(Point(vertices[indices[i + 1]]));
+        box.extend(Point(vertices[indices[i + 2]]));
+        bounds.push_back(box);
     }
+    BVH built;
+    built.build(bounds, LEAF_SIZE, INTERSECTION_COST);
+    return built;
 }
 
-const std::vector<Triangle> &Mesh::getTriangles() const {
-    return triangles;
+void Mesh::setMeshFiles(bool enabled) {
+    mesh_files = enabled;
 }
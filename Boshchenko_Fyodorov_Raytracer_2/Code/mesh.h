@@ -1,18 +1,49 @@
 #ifndef RAY_MESH_H
 #define RAY_MESH_H
 
-#include "shapes/triangle.h"
+#include "bvh.h"
+#include "triple.h"
 #include "vertex.h"
+#include <atomic>
 #include <fstream>
 #include <iostream>
+#include <memory>
 #include <string>
+#include <vector>
+
+class OBJLoader;
 
 class Mesh {
 public:
     Mesh(std::string filename);
-    const std::vector<Triangle> &getTriangles() const;
+
+    // vertex positions, already scaled and moved into the scene; they are
+    // computed in single precision, so float storage loses nothing
+    const std::vector<Pointf> &getVertices() const;
+
+    // three indices into getVertices() per triangle
+    const std::vector<unsigned> &getIndices() const;
+
+    unsigned numTriangles() const;
+
+    // The BVH of buildBVH() when it came with the mesh file, nullptr otherwise
+    const std::shared_ptr<BVH const> &getBVH() const;
+
+    // The BVH a MeshObject uses over the triangles
+    BVH buildBVH() const;
+
+    // Read compiled meshes from <obj>.mesh and write them there (see
+    // meshfile.h), BVH included; off by default
+    static void setMeshFiles(bool enabled);
+
 private:
-    std::vector<Triangle> triangles;
+    std::vector<Pointf> vertices;
+    std::vector<unsigned> indices;
+    std::shared_ptr<BVH const> bvh;
+
+    static std::atomic<bool> mesh_files;
+
+    void setGeometry(OBJLoader const &obj, std::string const &filename);
 };
 
 #endif //RAY_MESH_H
@@ -0,0 +1,153 @@
+#include "meshfile.h"
+#include "hash.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <cstdio>
+#include <cstring>
+
+using namespace std;
+
+namespace {
+
+char const MAGIC[8] = {'R', 'A', 'Y', 'M', 'E', 'S', 'H', '\n'};
+uint32_t const VERSION = 1;
+uint64_t const ALIGNMENT = 64;
+
+static_assert(sizeof(MeshFile::Header) == 192, "the header of a mesh file is 192 bytes");
+static_assert(sizeof(MeshFile::Node) == 64, "a BVH node of a mesh file is 64 bytes");
+
+uint64_t aligned(uint64_t offset) {
+    return (offset + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+}
+
+// A read-only mapping of a whole file, nullptr if it is empty or cannot be mapped
+shared_ptr<void const> mapFile(string const &filename, size_t &length) {
+    int fd = open(filename.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return nullptr;
+    }
+    struct stat info;
+    void *base = MAP_FAILED;
+    if (fstat(fd, &info) == 0 && info.st_size > 0) {
+        length = size_t(info.st_size);
+        base = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+    }
+    close(fd);  // the mapping stays valid
+    if (base == MAP_FAILED) {
+        return nullptr;
+    }
+    return shared_ptr<void const>(base, [length](void const *base) {
+        munmap(const_cast<void *>(base), length);
+    });
+}
+
+}
+
+size_t const MeshFile::ELEMENT_SIZE[NUM_SECTIONS] = {
+        3 * sizeof(float), 3 * sizeof(float), 2 * sizeof(float), 3 * sizeof(uint32_t), sizeof(Node),
+        sizeof(uint32_t)};
+
+string MeshFile::path(string const &obj_filename) {
+    return obj_filename + ".mesh";
+}
+
+bool MeshFile::open(string const &obj_filename, FileStamp const &stamp) {
+    mapping.reset();
+    size_t length = 0;
+    shared_ptr<void const> file = mapFile(path(obj_filename), length);
+    if (!file || length < sizeof(Header)) {
+        return false;
+    }
+    Header const &head = *static_cast<Header const *>(file.get());
+    if (memcmp(head.magic, MAGIC, sizeof MAGIC) != 0 || head.version != VERSION ||
+        head.obj_size != stamp.size) {
+        return false;
+    }
+    // Every section lies within the file, and the sections do not overlap the header
+    for (int section = 0; section < NUM_SECTIONS; ++section) {
+        uint64_t offset = head.offset[section], count = head.count[section];
+        if (offset % ALIGNMENT != 0 || offset < sizeof(Header) || offset > length ||
+            count > (length - offset) / ELEMENT_SIZE[section]) {
+            return false;
+        }
+    }
+
+    if (head.obj_mtime != stamp.mtime) {
+        // Touched, copied or checked out again: the bytes decide
+        uint64_t hash;
+        if (!hashFile(obj_filename, hash) || hash != head.obj_hash) {
+            return false;
+        }
+        // Best effort, so that the next run does not hash the OBJ again
+        int fd = ::open(path(obj_filename).c_str(), O_WRONLY);
+        if (fd >= 0) {
+            int64_t mtime = stamp.mtime;
+            ssize_t written = pwrite(fd, &mtime, sizeof mtime, offsetof(Header, obj_mtime));
+            static_cast<void>(written);
+            close(fd);
+        }
+    }
+    mapping = file;
+    return true;
+}
+
+bool MeshFile::write(string const &obj_filename, FileStamp const &stamp, Contents const &contents) {
+    Header head;
+    memset(&head, 0, sizeof head);
+    memcpy(head.magic, MAGIC, sizeof MAGIC);
+    head.version = VERSION;
+    head.flags = contents.flags;
+    head.obj_mtime = stamp.mtime;
+    head.obj_size = stamp.size;
+    head.bvh_key = contents.bvh_key;
+    FileStamp now;
+    if (!hashFile(obj_filename, head.obj_hash) || !FileStamp::read(obj_filename, now) || now != stamp) {
+        return false;
+    }
+    uint64_t offset = aligned(sizeof head);
+    for (int section = 0; section < NUM_SECTIONS; ++section) {
+        head.offset[section] = offset;
+        head.count[section] = contents.count[section];
+        offset = aligned(offset + contents.count[section] * ELEMENT_SIZE[section]);
+    }
+
+    string filename = path(obj_filename), temporary = filename + ".tmp" + to_string(getpid());
+    FILE *out = fopen(temporary.c_str(), "wb");
+    if (!out) {
+        return false;
+    }
+    bool ok = fwrite(&head, sizeof head, 1, out) == 1;
+    char const zeros[ALIGNMENT] = {};
+    uint64_t position = sizeof head;
+    for (int section = 0; section < NUM_SECTIONS && ok; ++section) {
+        size_t bytes = contents.count[section] * ELEMENT_SIZE[section];
+        ok = fwrite(zeros, 1, head.offset[section] - position, out) == head.offset[section] - position &&
+             (bytes == 0 || fwrite(contents.data[section], 1, bytes, out) == bytes);
+        position = head.offset[section] + bytes;
+    }
+    // Padded to a whole 64 bytes, so that every offset lies within the file
+    ok = ok && fwrite(zeros, 1, offset - position, out) == offset - position;
+    ok = fclose(out) == 0 && ok;
+    if (!ok || rename(temporary.c_str(), filename.c_str()) != 0) {
+        remove(temporary.c_str());
+        return false;
+    }
+    return true;
+}
+
+bool MeshFile::hashFile(string const &filename, uint64_t &hash) {
+    size_t length = 0;
+    shared_ptr<void const> file = mapFile(filename, length);
+    FileStamp stamp;
+    if (!file) {
+        // An empty file has nothing to map
+        hash = hashBytes(nullptr, 0);
+        return FileStamp::read(filename, stamp) && stamp.size == 0;
+    }
+    madvise(const_cast<void *>(file.get()), length, MADV_SEQUENTIAL);
+    hash = hashBytes(file.get(), length);
+    return true;
+}
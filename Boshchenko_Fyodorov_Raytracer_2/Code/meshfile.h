@@ -0,0 +1,111 @@
+#ifndef MESHFILE_H_
+#define MESHFILE_H_
+
+#include "filestamp.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+/**
+ * A compiled mesh: <obj>.mesh next to an OBJ file holds the arrays OBJLoader
+ * read from it and optionally the BVH built over its triangles, so that later
+ * runs map it read-only instead of parsing the text. Other programs can read
+ * it too: the file starts with a Header (below) and every section lies at
+ * the offset the header lists for it (a multiple of 64), in the byte order of
+ * the machine that wrote it:
+ *
+ *   COORDINATES  float x, y, z per "v" line
+ *   NORMALS      float x, y, z per "vn" line
+ *   TEX_COORDS   float u, v per "vt" line
+ *   VERTICES     uint32 coordinate, normal and texture index per face
+ *                vertex, counted from 0; the texture index is 0 for faces
+ *                before the first "vt" line
+ *   BVH_NODES    a Node per BVH node, empty when the file has no BVH
+ *   BVH_ORDER    uint32 triangle (a VERTICES triple) per BVH leaf position
+ *
+ * A file belongs to its OBJ while the size of the OBJ matches and either its
+ * modification time or the 64-bit FNV-1a hash of its bytes does, so an OBJ
+ * that was only touched or checked out again keeps its mesh file. Files are
+ * written to a temporary name and renamed, so a process never maps half of
+ * one.
+ */
+class MeshFile {
+public:
+    enum Section {
+        COORDINATES, NORMALS, TEX_COORDS, VERTICES, BVH_NODES, BVH_ORDER, NUM_SECTIONS
+    };
+
+    // Header::flags
+    static uint32_t const HAS_TEX_COORDS = 1;   // the OBJ has "vt" lines
+
+    // 192 bytes
+    struct Header {
+        char magic[8];              // "RAYMESH\n"
+        uint32_t version;
+        uint32_t flags;
+        int64_t obj_mtime;          // FileStamp of the OBJ
+        int64_t obj_size;
+        uint64_t obj_hash;          // 64-bit FNV-1a of the bytes of the OBJ
+        uint64_t bvh_key;           // how the BVH was built, up to the writer
+        uint64_t offset[NUM_SECTIONS];
+        uint64_t count[NUM_SECTIONS];   // elements, not bytes
+        char padding[48];
+    };
+
+    // Nodes are stored depth first: an inner node is followed by its left
+    // child and 'first' is its right child; a leaf covers the positions
+    // [first, first + count) of BVH_ORDER
+    struct Node {
+        double min[3];
+        double max[3];
+        uint32_t first;
+        uint32_t count;             // 0 for inner nodes
+        int32_t axis;               // split axis of an inner node
+        uint32_t padding;
+    };
+
+    // What write() stores, one array per section
+    struct Contents {
+        void const *data[NUM_SECTIONS];
+        uint64_t count[NUM_SECTIONS];
+        uint32_t flags;
+        uint64_t bvh_key;
+    };
+
+    // Bytes per element of every section
+    static size_t const ELEMENT_SIZE[NUM_SECTIONS];
+
+    // <obj>.mesh
+    static std::string path(std::string const &obj_filename);
+
+    // Maps the mesh file of an OBJ with this stamp; false if there is none,
+    // it belongs to another version of the OBJ or it is damaged
+    bool open(std::string const &obj_filename, FileStamp const &stamp);
+
+    Header const &header() const {
+        return *static_cast<Header const *>(mapping.get());
+    }
+
+    uint64_t count(Section section) const {
+        return header().count[section];
+    }
+
+    template<typename T>
+    T const *data(Section section) const {
+        return reinterpret_cast<T const *>(static_cast<char const *>(mapping.get()) + header().offset[section]);
+    }
+
+    // Best effort: stores contents as the mesh file of an OBJ whose stamp
+    // was taken before it was parsed; nothing is written if it changed since
+    static bool write(std::string const &obj_filename, FileStamp const &stamp, Contents const &contents);
+
+    // 64-bit FNV-1a of the bytes of a file; false if it cannot be read
+    static bool hashFile(std::string const &filename, uint64_t &hash);
+
+private:
+    std::shared_ptr<void const> mapping;
+};
+
+#endif
@@ -1,11 +1,12 @@
 #ifndef OBJECT_H_
 #define OBJECT_H_
 
-#include "material.h"
+#include "aabb.h"
 
 // not really needed here, but deriving classes may need them
 #include "hit.h"
 #include "ray.h"
+#include "raypacket.h"
 #include "triple.h"
 
 #include <memory>
@@ -16,17 +17,46 @@ typedef std::shared_ptr<Object> ObjectPtr;
 
 class Object {
 public:
-    Material material;
+    unsigned material_id = 0;   // index into the material table of the scene
 
     static double constexpr EPSILON = 0.000001;
     static double constexpr DEFAULT_SHININESS = 0.2;
 
     virtual ~Object() = default;
 
-    virtual Hit intersect(Ray const &ray) = 0;  // must be implemented
+    virtual Hit intersect(Ray const &ray) const = 0;  // must be implemented
     // in derived class
 
-    virtual std::pair<double, double> mapTextureCoord(Point &surface_point) {
+    // Any-hit query for shadow rays: does the ray hit this object before
+    // t_max? Shapes may override it to skip the normal and stop early.
+    virtual bool occluded(Ray const &ray, double t_max) const {
+        return intersect(ray).t < t_max;
+    }
+
+    // Packet version of intersect: every lane in 'lanes' for which this
+    // object is closer than hits.t gets updated. The default tests the
+    // lanes one by one, shapes may override it with a vectorized test.
+    virtual void intersectPacket(RayPacket const &packet, unsigned lanes, PacketHit &hits) const {
+        for (int lane = 0; lane < RayPacket::SIZE; ++lane) {
+            if (!(lanes & (1U << lane))) {
+                continue;
+            }
+            Hit hit(intersect(packet.ray(lane)));
+            if (hit.t < hits.t[lane]) {
+                hits.t[lane] = hit.t;
+                hits.N[lane] = hit.N;
+                hits.object[lane] = this;
+            }
+        }
+    }
+
+    // Bounds used by the BVH. Shapes without a finite extent keep the
+    // default and are tested against every ray instead.
+    virtual AABB boundingBox() const {
+        return AABB::infinite();
+    }
+
+    virtual std::pair<double, double> mapTextureCoord(Point const &surface_point) const {
         return std::make_pair(0, 0);
     };
 
@@ -3,22 +3,159 @@
 // Pro C++ Tip: here you can specify other includes you may need
 // such as <iostream>
 
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <charconv>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
 #include <fstream>
 #include <iostream>
 #include <sstream>
+#include <stdexcept>
+#include <thread>
 
 using namespace std;
 
+// What one thread parsed of its lines. Faces count from the start of the
+// file, so the chunks are only concatenated; a texture index is only read
+// once a "vt" line came before the face, which a chunk cannot know for the
+// lines before its own first "vt", so that is settled by merge().
+struct OBJLoader::Chunk {
+    vector<vec3> coordinates;
+    vector<vec3> normals;
+    vector<vec2> texCoords;
+    vector<Vertex_idx> vertices;
+    size_t before_tex = 0;          // face vertices before the first "vt" line
+    bool has_tex = false;
+    size_t missing_tex = SIZE_MAX;  // the last face vertex without a texture index
+    exception_ptr error;
+};
+
+namespace {
+
+// Lines of a mapped file are split into tokens at spaces, like split() does
+
+char const *skipSpaces(char const *pos, char const *end) {
+    while (pos < end && *pos == ' ')
+        ++pos;
+    return pos;
+}
+
+char const *tokenEnd(char const *pos, char const *end) {
+    while (pos < end && *pos != ' ')
+        ++pos;
+    return pos;
+}
+
+bool isToken(char const *begin, char const *end, char const *token) {
+    size_t length = strlen(token);
+    return size_t(end - begin) == length && memcmp(begin, token, length) == 0;
+}
+
+// Relative (negative) face indices are not supported by either parser:
+// stoul() would wrap them around to huge indices
+bool isNegative(char const *begin, char const *end) {
+    while (begin < end && isspace(static_cast<unsigned char>(*begin)))
+        ++begin;
+    return begin < end && *begin == '-';
+}
+
+// Read the same numbers as stof() and stoul() in parseLine() do. from_chars()
+// takes the plain decimal numbers of nearly every file; anything else (a
+// sign, leading whitespace, hex floats, trailing characters, subnormals,
+// NaN payloads) goes to strtof() and strtoul(), which stof() and stoul()
+// call, and is rejected where those throw.
+
+bool parseNumber(char const *begin, char const *end, float &value) {
+    from_chars_result result = from_chars(begin, end, value);
+    if (result.ec == errc() && result.ptr == end && (isnormal(value) || value == 0 || isinf(value)))
+        return true;
+
+    string text(begin, end);
+    char *stop;
+    errno = 0;
+    value = strtof(text.c_str(), &stop);
+    return stop != text.c_str() && errno != ERANGE;
+}
+
+bool parseNumber(char const *begin, char const *end, size_t &value) {
+    from_chars_result result = from_chars(begin, end, value);
+    if (result.ec == errc() && result.ptr == end)
+        return true;
+    if (isNegative(begin, end))
+        return false;
+
+    string text(begin, end);
+    char *stop;
+    errno = 0;
+    value = strtoul(text.c_str(), &stop, 10);
+    return stop != text.c_str() && errno != ERANGE;
+}
+
+// A face index of parseFace()
+size_t parseIndex(string const &text) {
+    if (isNegative(text.data(), text.data() + text.size()))
+        throw runtime_error("OBJLoader: relative face indices are not supported");
+    return stoul(text);
+}
+
+// The numbers after the keyword of a line
+template<size_t N>
+void parseNumbers(char const *pos, char const *end, float (&values)[N], char const *line) {
+    for (float &value : values) {
+        pos = skipSpaces(pos, end);
+        char const *token_end = tokenEnd(pos, end);
+        if (pos == end || !parseNumber(pos, token_end, value))
+            throw runtime_error("OBJLoader: cannot read \"" + string(line, end) + "\"");
+        pos = token_end;
+    }
+}
+
+// Chunks of a mapped file are at least this large, so that small files are parsed on one thread
+size_t const MIN_CHUNK = 1 << 20;
+
+}
+
 // ===================================================================
 // -- Constructors and destructor ------------------------------------
 // ===================================================================
 
 // --- Public --------------------------------------------------------
 
-OBJLoader::OBJLoader(string const &filename)
+OBJLoader::OBJLoader(string const &filename, Parser parser, unsigned threads)
         :
         d_hasTexCoords(false) {
-    parseFile(filename);
+    if (parser == STREAM)
+        parseFile(filename);
+    else
+        parseMapped(filename, threads);
+}
+
+OBJLoader::OBJLoader(MeshFile const &file)
+        :
+        d_hasTexCoords((file.header().flags & MeshFile::HAS_TEX_COORDS) != 0) {
+    vec3 const *coordinates = file.data<vec3>(MeshFile::COORDINATES);
+    d_coordinates.assign(coordinates, coordinates + file.count(MeshFile::COORDINATES));
+    vec3 const *normals = file.data<vec3>(MeshFile::NORMALS);
+    d_normals.assign(normals, normals + file.count(MeshFile::NORMALS));
+    vec2 const *texCoords = file.data<vec2>(MeshFile::TEX_COORDS);
+    d_texCoords.assign(texCoords, texCoords + file.count(MeshFile::TEX_COORDS));
+
+    uint32_t const *indices = file.data<uint32_t>(MeshFile::VERTICES);
+    d_vertices.resize(file.count(MeshFile::VERTICES));
+    for (Vertex_idx &vertex : d_vertices) {
+        vertex.d_coord = *indices++;
+        vertex.d_norm = *indices++;
+        vertex.d_tex = *indices++;
+    }
 }
 
 // ===================================================================
@@ -61,6 +198,53 @@ vector<Vertex> OBJLoader::vertex_data() const {
     return data;    // copy elision
 }
 
+vector<Vertex> OBJLoader::coordinate_data() const {
+    vector<Vertex> data;
+    data.reserve(d_coordinates.size());
+    for (vec3 const &coord : d_coordinates) {
+        Vertex vert{};  // normal and texture data stay zero
+        vert.x = coord.x;
+        vert.y = coord.y;
+        vert.z = coord.z;
+        data.push_back(vert);
+    }
+    return data;
+}
+
+vector<unsigned> OBJLoader::coordinate_indices() const {
+    vector<unsigned> indices;
+    indices.reserve(d_vertices.size());
+    for (Vertex_idx const &vertex : d_vertices)
+        indices.push_back(static_cast<unsigned>(vertex.d_coord));
+    return indices;
+}
+
+bool OBJLoader::meshFileContents(MeshFile::Contents &contents, vector<uint32_t> &indices) const {
+    static_assert(sizeof(vec3) == 3 * sizeof(float) && sizeof(vec2) == 2 * sizeof(float),
+                  "coordinates are stored as they are in memory");
+    indices.clear();
+    indices.reserve(3 * d_vertices.size());
+    for (Vertex_idx const &vertex : d_vertices) {
+        for (size_t index : {vertex.d_coord, vertex.d_norm, vertex.d_tex}) {
+            if (index > UINT32_MAX)
+                return false;
+            indices.push_back(static_cast<uint32_t>(index));
+        }
+    }
+
+    contents = MeshFile::Contents{};
+    contents.data[MeshFile::COORDINATES] = d_coordinates.data();
+    contents.count[MeshFile::COORDINATES] = d_coordinates.size();
+    contents.data[MeshFile::NORMALS] = d_normals.data();
+    contents.count[MeshFile::NORMALS] = d_normals.size();
+    contents.data[MeshFile::TEX_COORDS] = d_texCoords.data();
+    contents.count[MeshFile::TEX_COORDS] = d_texCoords.size();
+    contents.data[MeshFile::VERTICES] = indices.data();
+    contents.count[MeshFile::VERTICES] = d_vertices.size();
+    contents.flags = d_hasTexCoords ? MeshFile::HAS_TEX_COORDS : 0;
+    return true;
+}
+
 unsigned OBJLoader::numTriangles() const {
     return d_vertices.size() / 3U;
 }
@@ -108,6 +292,140 @@ void OBJLoader::parseFile(string const &filename) {
     }
 }
 
+void OBJLoader::parseMapped(string const &filename, unsigned threads) {
+    int fd = open(filename.c_str(), O_RDONLY);
+    struct stat info;
+    if (fd < 0 || fstat(fd, &info) != 0) {
+        if (fd >= 0)
+            close(fd);
+        cerr << "Could not open: " << filename << " for reading!\n";
+        return;
+    }
+    size_t size = size_t(info.st_size);
+    void *base = size > 0 ? mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+    close(fd);      // the mapping stays valid
+    if (size == 0)
+        return;
+    if (base == MAP_FAILED) {
+        cerr << "Could not open: " << filename << " for reading!\n";
+        return;
+    }
+    madvise(base, size, MADV_SEQUENTIAL);
+
+    // Every chunk starts at the beginning of a line
+    char const *text = static_cast<char const *>(base), *text_end = text + size;
+    if (threads == 0)
+        threads = max(1U, thread::hardware_concurrency());
+    size_t count = max<size_t>(1, min<size_t>(threads, size / MIN_CHUNK));
+    vector<char const *> bounds{text};
+    for (size_t idx = 1; idx < count; ++idx) {
+        char const *pos = max(text + idx * size / count, bounds.back());
+        pos = static_cast<char const *>(memchr(pos, '\n', text_end - pos));
+        bounds.push_back(pos ? pos + 1 : text_end);
+    }
+    bounds.push_back(text_end);
+
+    vector<Chunk> chunks(count);
+    auto parse = [&](size_t idx) {
+        try {
+            parseChunk(bounds[idx], bounds[idx + 1], chunks[idx]);
+        } catch (...) {
+            chunks[idx].error = current_exception();
+        }
+    };
+    vector<thread> workers;
+    for (size_t idx = 1; idx < count; ++idx)
+        workers.emplace_back(parse, idx);
+    parse(0);
+    for (thread &worker : workers)
+        worker.join();
+    munmap(base, size);
+
+    merge(chunks);
+}
+
+void OBJLoader::parseChunk(char const *begin, char const *end, Chunk &chunk) {
+    for (char const *line = begin; line < end;) {
+        char const *eol = static_cast<char const *>(memchr(line, '\n', end - line));
+        if (!eol)
+            eol = end;
+        char const *keyword = skipSpaces(line, eol), *keyword_end = tokenEnd(keyword, eol);
+
+        if (isToken(keyword, keyword_end, "v") || isToken(keyword, keyword_end, "vn")) {
+            float values[3];
+            parseNumbers(keyword_end, eol, values, line);
+            (keyword_end - keyword == 1 ? chunk.coordinates : chunk.normals).push_back(
+                    vec3{values[0], values[1], values[2]});
+        } else if (isToken(keyword, keyword_end, "vt")) {
+            if (!chunk.has_tex) {
+                chunk.has_tex = true;
+                chunk.before_tex = chunk.vertices.size();
+            }
+            float values[2];
+            parseNumbers(keyword_end, eol, values, line);
+            chunk.texCoords.push_back(vec2{values[0], values[1]});
+        } else if (isToken(keyword, keyword_end, "f")) {
+            // <vertex idx + 1>/<texture idx + 1>/<normal idx + 1>, the texture index may be empty
+            for (char const *pos = skipSpaces(keyword_end, eol); pos < eol; pos = skipSpaces(pos, eol)) {
+                char const *token_end = tokenEnd(pos, eol);
+                char const *slash1 = find(pos, token_end, '/');
+                char const *slash2 = slash1 == token_end ? token_end : find(slash1 + 1, token_end, '/');
+                Vertex_idx vertex{};
+                if (slash2 == token_end || !parseNumber(pos, slash1, vertex.d_coord) ||
+                    !parseNumber(slash2 + 1, find(slash2 + 1, token_end, '/'), vertex.d_norm))
+                    throw runtime_error("OBJLoader: cannot read \"" + string(line, eol) + "\"");
+                if (!parseNumber(slash1 + 1, slash2, vertex.d_tex))
+                    chunk.missing_tex = chunk.vertices.size();
+                vertex.d_coord -= 1U;
+                vertex.d_tex -= 1U;
+                vertex.d_norm -= 1U;
+                chunk.vertices.push_back(vertex);
+                pos = token_end;
+            }
+        }
+        // Other data, comments and empty lines are ignored
+
+        line = eol + 1;
+    }
+    if (!chunk.has_tex)
+        chunk.before_tex = chunk.vertices.size();
+}
+
+void OBJLoader::merge(vector<Chunk> &chunks) {
+    size_t coordinates = 0, normals = 0, texCoords = 0, vertices = 0;
+    size_t first_tex = SIZE_MAX;    // face vertices before the first "vt" line of the file
+    for (Chunk &chunk : chunks) {
+        if (chunk.error)
+            rethrow_exception(chunk.error);
+        if (chunk.has_tex && first_tex == SIZE_MAX)
+            first_tex = vertices + chunk.before_tex;
+        if (chunk.missing_tex != SIZE_MAX && first_tex != SIZE_MAX &&
+            vertices + chunk.missing_tex >= first_tex)
+            throw runtime_error("OBJLoader: face without a texture index");
+        coordinates += chunk.coordinates.size();
+        normals += chunk.normals.size();
+        texCoords += chunk.texCoords.size();
+        vertices += chunk.vertices.size();
+    }
+
+    d_hasTexCoords = first_tex != SIZE_MAX;
+    d_coordinates.reserve(coordinates);
+    d_normals.reserve(normals);
+    d_texCoords.reserve(texCoords);
+    d_vertices.reserve(vertices);
+    for (Chunk &chunk : chunks) {
+        d_coordinates.insert(d_coordinates.end(), chunk.coordinates.begin(), chunk.coordinates.end());
+        d_normals.insert(d_normals.end(), chunk.normals.begin(), chunk.normals.end());
+        d_texCoords.insert(d_texCoords.end(), chunk.texCoords.begin(), chunk.texCoords.end());
+        d_vertices.insert(d_vertices.end(), chunk.vertices.begin(), chunk.vertices.end());
+        chunk = Chunk();
+    }
+
+    // Faces before the first "vt" line get texture index 0, as parseFace() ignores theirs
+    for (size_t idx = 0; idx < min(first_tex, d_vertices.size()); ++idx)
+        d_vertices[idx].d_tex = 0;
+}
+
 void OBJLoader::parseLine(string const &line) {
     if (line[0] == '#')
         return;                     // ignore comments
@@ -161,14 +479,14 @@ void OBJLoader::parseFace(StringList const &tokens) {
         StringList elements = split(tokens.at(idx), '/');
         Vertex_idx vertex{}; // initialize to zeros on all fields
 
-        vertex.d_coord = stoul(elements.at(0)) - 1U;
+        vertex.d_coord = parseIndex(elements.at(0)) - 1U;
 
         if (d_hasTexCoords)
-            vertex.d_tex = stoul(elements.at(1)) - 1U;
+            vertex.d_tex = parseIndex(elements.at(1)) - 1U;
         else
             vertex.d_tex = 0U;       // ignored
 
-        vertex.d_norm = stoul(elements.at(2)) - 1U;
+        vertex.d_norm = parseIndex(elements.at(2)) - 1U;
 
         d_vertices.push_back(vertex);
     }
@@ -5,6 +5,7 @@
 // header file (.h), other headers you need should go in your source
 // file (.cpp / .cc)
 
+#include "meshfile.h"
 #include "vertex.h"
 
 #include <string>
@@ -44,13 +45,44 @@ class OBJLoader {
 
     typedef std::vector<std::string> StringList;
 
+    // What one thread parsed of a MAPPED file, see parseChunk()
+    struct Chunk;
+
 public:
 
+    /**
+     * @brief The Parser enum
+     * MAPPED maps the file into memory and parses it in place, in
+     * chunks of lines on several threads for a large file; STREAM
+     * reads it line by line with getline and splits every line into
+     * strings. Both give the same data.
+     */
+    enum Parser {
+        MAPPED, STREAM
+    };
+
     /**
      * @brief OBJLoader
      * @param filename
+     * @param parser
+     * @param threads for MAPPED, 0: one per core
+     */
+    explicit OBJLoader(std::string const &filename, Parser parser = MAPPED, unsigned threads = 0);
+
+    /**
+     * @brief OBJLoader the data of a compiled mesh file, the same
+     *  as parsing the OBJ it belongs to
+     * @param file an open MeshFile
+     */
+    explicit OBJLoader(MeshFile const &file);
+
+    /**
+     * @brief meshFileContents the data to store in a MeshFile,
+     *  without a BVH
+     * @param indices receives the face vertices, which point into it
+     * @return false if an index does not fit into 32 bits
      */
-    explicit OBJLoader(std::string const &filename);
+    bool meshFileContents(MeshFile::Contents &contents, std::vector<uint32_t> &indices) const;
 
     /**
      * @brief vertex_data
@@ -61,6 +93,20 @@ public:
      */
     std::vector<Vertex> vertex_data() const;
 
+    /**
+     * @brief coordinate_data
+     * @return every distinct vertex coordinate of the file, only
+     *  x, y and z are set
+     */
+    std::vector<Vertex> coordinate_data() const;
+
+    /**
+     * @brief coordinate_indices
+     * @return for every vertex of vertex_data() the index of its
+     *  coordinate in coordinate_data(), i.e. 3 indices per triangle
+     */
+    std::vector<unsigned> coordinate_indices() const;
+
     unsigned numTriangles() const;
 
     bool hasTexCoords() const;
@@ -76,6 +122,12 @@ private:
 
     void parseFile(std::string const &filename);
 
+    void parseMapped(std::string const &filename, unsigned threads);
+
+    static void parseChunk(char const *begin, char const *end, Chunk &chunk);
+
+    void merge(std::vector<Chunk> &chunks);
+
     void parseLine(std::string const &line);
 
     void parseVertex(StringList const &tokens);
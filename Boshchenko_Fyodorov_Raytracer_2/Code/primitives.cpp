@@ -0,0 +1,176 @@
+#include "primitives.h"
+#include "stats.h"
+#include "shapes/cylinder.h"
+#include "shapes/sphere.h"
+#include "shapes/triangle.h"
+
+#include <typeinfo>
+
+using namespace std;
+
+void PrimitiveTable::build(vector<Object const *> const &objects, BVH const &bvh) {
+    spheres.clear();
+    sphere_objects.clear();
+    triangles.clear();
+    triangle_objects.clear();
+    cylinders.clear();
+    cylinder_objects.clear();
+    others.clear();
+    entries.assign(objects.size(), Entry{OTHER, 0});
+    leaf_size.assign(objects.size(), 0);
+
+    // The type is looked up once here instead of on every ray. Only the exact
+    // types use the typed kernels: a subclass may intersect differently.
+    for (BVH::Node const &node : bvh.getNodes()) {
+        if (node.count == 0) {
+            continue;
+        }
+        leaf_size[node.first] = node.count;
+        for (unsigned pos = node.first; pos < node.first + node.count; ++pos) {
+            Object const *object = objects[pos];
+            type_info const &type = typeid(*object);
+            if (type == typeid(Sphere)) {
+                Sphere const *sphere = static_cast<Sphere const *>(object);
+                entries[pos] = Entry{SPHERE, static_cast<unsigned>(spheres.size())};
+                spheres.push_back(SphereData{sphere->center, sphere->radius});
+                sphere_objects.push_back(object);
+            } else if (type == typeid(Triangle)) {
+                Triangle const *triangle = static_cast<Triangle const *>(object);
+                entries[pos] = Entry{TRIANGLE, static_cast<unsigned>(triangles.size())};
+                triangles.push_back(TriangleData{triangle->a, triangle->b, triangle->c});
+                triangle_objects.push_back(object);
+            } else if (type == typeid(Cylinder)) {
+                Cylinder const *cylinder = static_cast<Cylinder const *>(object);
+                entries[pos] = Entry{CYLINDER, static_cast<unsigned>(cylinders.size())};
+                cylinders.push_back(CylinderData{cylinder->center, cylinder->radius, cylinder->height});
+                cylinder_objects.push_back(object);
+            } else {
+                entries[pos] = Entry{OTHER, static_cast<unsigned>(others.size())};
+                others.push_back(object);
+            }
+        }
+    }
+}
+
+Object const *PrimitiveTable::intersectLeaf(unsigned first, Ray const &ray, Hit &min_hit) const {
+    RenderCounters &counters = threadCounters();
+    Object const *obj = nullptr;
+
+    for (unsigned pos = first; pos < first + leaf_size[first]; ++pos) {
+        unsigned idx = entries[pos].index;
+        switch (entries[pos].kind) {
+            case SPHERE: {
+                ++counters.sphere_tests;
+                double t = sphereDistance(spheres[idx].center, spheres[idx].radius, ray);
+                if (t < min_hit.t) {
+                    min_hit = Hit(t, sphereNormal(spheres[idx].center, ray, t));
+                    obj = sphere_objects[idx];
+                }
+                break;
+            }
+            case TRIANGLE: {
+                ++counters.triangle_tests;
+                TriangleData const &triangle = triangles[idx];
+                double t = triangleDistance(triangle.a, triangle.b, triangle.c, ray);
+                if (t < min_hit.t) {
+                    min_hit = Hit(t, positionNormal(ray, t));
+                    obj = triangle_objects[idx];
+                }
+                break;
+            }
+            case CYLINDER: {
+                ++counters.cylinder_tests;
+                CylinderData const &cylinder = cylinders[idx];
+                double t = cylinderDistance(cylinder.center, cylinder.radius, cylinder.height, ray);
+                if (t < min_hit.t) {
+                    min_hit = Hit(t, positionNormal(ray, t));
+                    obj = cylinder_objects[idx];
+                }
+                break;
+            }
+            case OTHER: {
+                Hit hit(others[idx]->intersect(ray));
+                if (hit.t < min_hit.t) {
+                    min_hit = hit;
+                    obj = others[idx];
+                }
+                break;
+            }
+        }
+    }
+    return obj;
+}
+
+bool PrimitiveTable::occludedLeaf(unsigned first, Ray const &ray, double t_max) const {
+    RenderCounters &counters = threadCounters();
+
+    for (unsigned pos = first; pos < first + leaf_size[first]; ++pos) {
+        unsigned idx = entries[pos].index;
+        bool blocked = false;
+        switch (entries[pos].kind) {
+            case SPHERE:
+                ++counters.sphere_tests;
+                blocked = sphereDistance(spheres[idx].center, spheres[idx].radius, ray) < t_max;
+                break;
+            case TRIANGLE:
+                ++counters.triangle_tests;
+                blocked = triangleDistance(triangles[idx].a, triangles[idx].b, triangles[idx].c, ray) < t_max;
+                break;
+            case CYLINDER:
+                ++counters.cylinder_tests;
+                blocked = cylinderDistance(cylinders[idx].center, cylinders[idx].radius, cylinders[idx].height,
+                                           ray) < t_max;
+                break;
+            case OTHER:
+                blocked = others[idx]->occluded(ray, t_max);
+                break;
+        }
+        if (blocked) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void PrimitiveTable::intersectLeafPacket(unsigned first, RayPacket const &packet, unsigned lanes,
+                                         PacketHit &hits) const {
+    RenderCounters &counters = threadCounters();
+    unsigned active = static_cast<unsigned>(__builtin_popcount(lanes));
+
+    for (unsigned pos = first; pos < first + leaf_size[first]; ++pos) {
+        unsigned idx = entries[pos].index;
+        switch (entries[pos].kind) {
+            case SPHERE:
+                counters.sphere_tests += active;
+                spherePacket(spheres[idx].center, spheres[idx].radius, packet, lanes, hits, sphere_objects[idx]);
+                break;
+            case TRIANGLE: {
+                counters.triangle_tests += active;
+                TriangleData const &triangle = triangles[idx];
+                trianglePacket(triangle.a, triangle.b, triangle.c, packet, lanes, hits, triangle_objects[idx]);
+                break;
+            }
+            case CYLINDER: {
+                // No packet kernel for cylinders, their lanes go one by one
+                counters.cylinder_tests += active;
+                CylinderData const &cylinder = cylinders[idx];
+                for (int lane = 0; lane < RayPacket::SIZE; ++lane) {
+                    if (!(lanes & (1U << lane))) {
+                        continue;
+                    }
+                    Ray ray(packet.ray(lane));
+                    double t = cylinderDistance(cylinder.center, cylinder.radius, cylinder.height, ray);
+                    if (t < hits.t[lane]) {
+                        hits.t[lane] = t;
+                        hits.N[lane] = positionNormal(ray, t);
+                        hits.object[lane] = cylinder_objects[idx];
+                    }
+                }
+                break;
+            }
+            case OTHER:
+                others[idx]->intersectPacket(packet, lanes, hits);
+                break;
+        }
+    }
+}
@@ -0,0 +1,254 @@
+#ifndef PRIMITIVES_H_
+#define PRIMITIVES_H_
+
+#include "bvh.h"
+#include "hit.h"
+#include "object.h"
+#include "ray.h"
+#include "raypacket.h"
+#include "triple.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+/**
+ * Intersection kernels of the simple shapes on plain geometry. The shape
+ * classes forward to them and so does PrimitiveTable, which keeps the same
+ * arithmetic (and thus the same images) on both paths.
+ */
+
+// --- Sphere ------------------------------------------------------------------
+
+// distance to the nearest hit in front of the ray origin, NaN if there is none
+inline double sphereDistance(Point const &center, double radius, Ray const &ray) {
+    double const no_hit = std::numeric_limits<double>::quiet_NaN();
+    Vector L = ray.O - center; // Direction from the sphere  center towards the origin of the ray
+    double a = ray.D.dot(ray.D),
+            b = 2 * ray.D.dot(L),
+            c = L.dot(L) - radius * radius;
+    double delta = b * b - 4 * a * c;
+    if (delta < 0) {
+        return no_hit;
+    }
+    double t1 = (-b - std::sqrt(delta)) / (2.0 * a),
+            t2 = (-b + std::sqrt(delta)) / (2.0 * a);
+    if (t1 < 0 && t2 < 0) {
+        return no_hit;
+    }
+    double t;
+    if (t1 < 0) {
+        t = t2;
+    } else if (t2 < 0) {
+        t = t1;
+    } else {
+        t = std::min(t1, t2);
+    }
+    if (t < Object::EPSILON) {
+        // Without such check, there will be a grainy picture because of a floating-point accuracy problem.
+        return no_hit;
+    }
+    return t;
+}
+
+inline Vector sphereNormal(Point const &center, Ray const &ray, double t) {
+    return (ray.at(t) - center).normalized();
+}
+
+// Same arithmetic as sphereDistance, written per lane so that the loop vectorizes
+inline void spherePacket(Point const &center, double radius, RayPacket const &packet, unsigned lanes,
+                         PacketHit &hits, Object const *object) {
+    double Lx = packet.O.x - center.x,
+            Ly = packet.O.y - center.y,
+            Lz = packet.O.z - center.z;
+    double c = (Lx * Lx + Ly * Ly + Lz * Lz) - radius * radius;
+    double t[RayPacket::SIZE];
+    for (int lane = 0; lane < RayPacket::SIZE; ++lane) {
+        double dx = packet.dx[lane], dy = packet.dy[lane], dz = packet.dz[lane];
+        double a = dx * dx + dy * dy + dz * dz,
+                b = 2 * (dx * Lx + dy * Ly + dz * Lz);
+        double delta = b * b - 4 * a * c;
+        double root = std::sqrt(std::fmax(delta, 0.0));
+        double t1 = (-b - root) / (2.0 * a),
+                t2 = (-b + root) / (2.0 * a);
+        double nearest = t1 < 0 ? t2 : (t2 < 0 ? t1 : std::min(t1, t2));
+        bool hit = delta >= 0 && !(t1 < 0 && t2 < 0) && nearest >= Object::EPSILON;
+        t[lane] = hit ? nearest : std::numeric_limits<double>::infinity();
+    }
+
+    for (int lane = 0; lane < RayPacket::SIZE; ++lane) {
+        if ((lanes & (1U << lane)) && t[lane] < hits.t[lane]) {
+            hits.t[lane] = t[lane];
+            hits.N[lane] = sphereNormal(center, packet.ray(lane), t[lane]);
+            hits.object[lane] = object;
+        }
+    }
+}
+
+// --- Triangle ----------------------------------------------------------------
+
+// Möller–Trumbore test, returns the distance along the ray or NaN if there is no hit
+inline double triangleDistance(Point const &a, Point const &b, Point const &c, Ray const &ray) {
+    double const no_hit = std::numeric_limits<double>::quiet_NaN();
+    double const EPSILON = Object::EPSILON;
+    Vector ab = b - a, ac = c - a;
+    Vector pvec = ray.D.cross(ac);
+    double determinant = ab.dot(pvec);
+    if (determinant > -EPSILON && determinant < EPSILON) {
+        return no_hit;
+    }
+
+    double invDeterminant = 1.0 / determinant;
+    Vector tvec = ray.O - a;
+    double u = tvec.dot(pvec) * invDeterminant;
+    if (u < 0.0 || u > 1.0) {
+        return no_hit;
+    }
+
+    Vector qvec = tvec.cross(ab);
+    double v = invDeterminant * ray.D.dot(qvec);
+    if (v < 0.0 || u + v > 1.0) {
+        return no_hit;
+    }
+
+    double t = invDeterminant * ac.dot(qvec);
+    return t > EPSILON ? t : no_hit;
+}
+
+// The triangles (and cylinders) of this ray tracer use the normalized hit position as normal
+inline Vector positionNormal(Ray const &ray, double t) {
+    return ray.at(t).normalized();
+}
+
+// Same arithmetic as triangleDistance, written per lane so that the loop vectorizes.
+// With a shared origin tvec and qvec are the same for every lane.
+inline void trianglePacket(Point const &a, Point const &b, Point const &c, RayPacket const &packet,
+                           unsigned lanes, PacketHit &hits, Object const *object) {
+    double const EPSILON = Object::EPSILON;
+    double abx = b.x - a.x, aby = b.y - a.y, abz = b.z - a.z,
+            acx = c.x - a.x, acy = c.y - a.y, acz = c.z - a.z;
+    double tx = packet.O.x - a.x, ty = packet.O.y - a.y, tz = packet.O.z - a.z;
+    double qx = ty * abz - tz * aby,
+            qy = tz * abx - tx * abz,
+            qz = tx * aby - ty * abx;
+    double t[RayPacket::SIZE];
+    for (int lane = 0; lane < RayPacket::SIZE; ++lane) {
+        double dx = packet.dx[lane], dy = packet.dy[lane], dz = packet.dz[lane];
+        double px = dy * acz - dz * acy,
+                py = dz * acx - dx * acz,
+                pz = dx * acy - dy * acx;
+        double determinant = abx * px + aby * py + abz * pz;
+        double invDeterminant = 1.0 / determinant;
+        double u = (tx * px + ty * py + tz * pz) * invDeterminant;
+        double v = invDeterminant * (dx * qx + dy * qy + dz * qz);
+        double distance = invDeterminant * (acx * qx + acy * qy + acz * qz);
+        bool hit = !(determinant > -EPSILON && determinant < EPSILON) &&
+                   !(u < 0.0 || u > 1.0) && !(v < 0.0 || u + v > 1.0) && distance > EPSILON;
+        t[lane] = hit ? distance : std::numeric_limits<double>::infinity();
+    }
+
+    for (int lane = 0; lane < RayPacket::SIZE; ++lane) {
+        if ((lanes & (1U << lane)) && t[lane] < hits.t[lane]) {
+            hits.t[lane] = t[lane];
+            hits.N[lane] = positionNormal(packet.ray(lane), t[lane]);
+            hits.object[lane] = object;
+        }
+    }
+}
+
+// --- Cylinder ----------------------------------------------------------------
+
+// distance to the hit in front of the ray origin, NaN if there is none
+inline double cylinderDistance(Point const &center, double radius, double height, Ray const &ray) {
+    double const no_hit = std::numeric_limits<double>::quiet_NaN();
+    double a = (ray.D.x * ray.D.x) + (ray.D.z * ray.D.z);
+    double b = 2 * (ray.D.x * (ray.O.x - center.x) + ray.D.z * (ray.O.z - center.z));
+    double c = (ray.O.x - center.x) * (ray.O.x - center.x) + (ray.O.z - center.z) * (ray.O.z - center.z) -
+               (radius * radius);
+
+    double delta = b * b - 4 * (a * c);
+    if (std::fabs(delta) < 0.001) return no_hit;
+    if (delta < 0.0) return no_hit;
+
+    double t1 = (-b - std::sqrt(delta)) / (2 * a);
+    double t2 = (-b + std::sqrt(delta)) / (2 * a);
+    double t;
+
+    if (t1 > t2) std::swap(t1, t2);
+    // Hits behind the ray origin do not count, just like for the sphere.
+    if (t1 >= Object::EPSILON) t = t1;
+    else if (t2 >= Object::EPSILON) t = t2;
+    else return no_hit;
+
+    double r = ray.O.y + t * ray.D.y;
+
+    if (r >= center.y and r <= center.y + height) {
+        return t;
+    }
+    return no_hit;
+}
+
+// --- PrimitiveTable ----------------------------------------------------------
+
+struct SphereData {
+    Point center;
+    double radius;
+};
+
+struct TriangleData {
+    Point a, b, c;
+};
+
+struct CylinderData {
+    Point center;
+    double radius, height;
+};
+
+/**
+ * Data-oriented copy of the bounded scene objects: spheres, triangles and
+ * cylinders go into contiguous per-type arrays, and every BVH position gets
+ * an entry with the exact type of its object and its index in that array.
+ * A leaf is tested in its original order, so ties at the same t go to the
+ * same object as without the table, with a switch on the type instead of a
+ * virtual call per object. Shapes without a typed kernel (meshes, subclasses
+ * of the simple shapes, user-defined objects) keep the virtual calls. The
+ * Object classes stay the builders and are still used for shading through
+ * the parallel *_objects arrays.
+ */
+class PrimitiveTable {
+public:
+    // objects in BVH leaf order, as Scene keeps them
+    void build(std::vector<Object const *> const &objects, BVH const &bvh);
+
+    // Nearest hit in the leaf that starts at position 'first'; updates
+    // min_hit and returns the object when it is closer than min_hit.t
+    Object const *intersectLeaf(unsigned first, Ray const &ray, Hit &min_hit) const;
+
+    // whether any primitive of the leaf blocks the ray before t_max
+    bool occludedLeaf(unsigned first, Ray const &ray, double t_max) const;
+
+    void intersectLeafPacket(unsigned first, RayPacket const &packet, unsigned lanes, PacketHit &hits) const;
+
+private:
+    enum Kind : unsigned char {
+        SPHERE, TRIANGLE, CYLINDER, OTHER
+    };
+
+    struct Entry {
+        Kind kind;
+        unsigned index;             // into the array of its kind
+    };
+
+    std::vector<SphereData> spheres;
+    std::vector<Object const *> sphere_objects;
+    std::vector<TriangleData> triangles;
+    std::vector<Object const *> triangle_objects;
+    std::vector<CylinderData> cylinders;
+    std::vector<Object const *> cylinder_objects;
+    std::vector<Object const *> others;
+    std::vector<Entry> entries;     // one per BVH position
+    std::vector<unsigned> leaf_size;    // indexed by the first position of a leaf
+};
+
+#endif
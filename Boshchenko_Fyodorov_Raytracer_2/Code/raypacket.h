@@ -0,0 +1,89 @@
+#ifndef RAYPACKET_H_
+#define RAYPACKET_H_
+
+#include "ray.h"
+#include "triple.h"
+
+#include <cmath>
+#include <limits>
+
+class Object;
+
+/**
+ * SIZE coherent rays that share their origin, e.g. the primary rays through
+ * the same sub-pixel position of a 2x2 block of pixels. Directions are kept
+ * per component so that loops over the lanes vectorize.
+ */
+struct RayPacket {
+    static int constexpr SIZE = 4;
+
+    Point O;                            // shared origin
+    double dx[SIZE], dy[SIZE], dz[SIZE];
+    double inv_dx[SIZE], inv_dy[SIZE], inv_dz[SIZE];
+    unsigned active = 0;                // bit mask of the lanes in use
+
+    // Per axis range of 1 / direction, valid where 'cullable' is set:
+    // all lanes have a non-zero direction of the same sign on that axis
+    double inv_lo[3], inv_hi[3];
+    bool cullable[3];
+
+    explicit RayPacket(Point const &origin)
+            :
+            O(origin),
+            dx(), dy(), dz(),
+            inv_dx(), inv_dy(), inv_dz() {}
+
+    void setLane(int lane, Vector const &D) {
+        dx[lane] = D.x;
+        dy[lane] = D.y;
+        dz[lane] = D.z;
+        active |= 1U << lane;
+    }
+
+    Ray ray(int lane) const {
+        return Ray(O, Vector(dx[lane], dy[lane], dz[lane]));
+    }
+
+    // Computes the inverse directions and their ranges, call after the last setLane
+    void prepare() {
+        for (int lane = 0; lane < SIZE; ++lane) {
+            inv_dx[lane] = 1.0 / dx[lane];
+            inv_dy[lane] = 1.0 / dy[lane];
+            inv_dz[lane] = 1.0 / dz[lane];
+        }
+        double const *dir[3] = {dx, dy, dz};
+        for (int axis = 0; axis < 3; ++axis) {
+            double lo = std::numeric_limits<double>::infinity(), hi = -lo;
+            bool positive = true, negative = true;
+            for (int lane = 0; lane < SIZE; ++lane) {
+                if (!(active & (1U << lane))) {
+                    continue;
+                }
+                double d = dir[axis][lane];
+                positive = positive && d > 0;
+                negative = negative && d < 0;
+                lo = std::fmin(lo, 1.0 / d);
+                hi = std::fmax(hi, 1.0 / d);
+            }
+            cullable[axis] = positive || negative;
+            inv_lo[axis] = lo;
+            inv_hi[axis] = hi;
+        }
+    }
+};
+
+// Nearest hit per lane of a RayPacket
+struct PacketHit {
+    double t[RayPacket::SIZE];
+    Vector N[RayPacket::SIZE];
+    Object const *object[RayPacket::SIZE];
+
+    PacketHit() {
+        for (int lane = 0; lane < RayPacket::SIZE; ++lane) {
+            t[lane] = std::numeric_limits<double>::infinity();
+            object[lane] = nullptr;
+        }
+    }
+};
+
+#endif
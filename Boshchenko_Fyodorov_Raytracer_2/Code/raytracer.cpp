@@ -1,5 +1,7 @@
 #include "raytracer.h"
 
+#include "filestamp.h"
+#include "hash.h"
 #include "image.h"
 
 // =============================================================================
@@ -10,6 +12,7 @@
 #include "shapes/triangle.h"
 #include "shapes/cone.h"
 #include "shapes/cylinder.h"
+#include "shapes/meshobject.h"
 #include "mesh.h"
 
 // =============================================================================
@@ -20,6 +23,12 @@
 
 #include <fstream>
 #include <iostream>
+#include <iterator>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
 
 using namespace std;        // no std:: required
 using json = nlohmann::json;
@@ -27,12 +36,18 @@ using json = nlohmann::json;
 bool Raytracer::parseObjectNode(json const &node) {
     ObjectPtr obj = nullptr;
 
+    // Optional offset of the whole object, e.g. per frame of an animation
+    Vector translate(0, 0, 0);
+    if (node.find("translate") != node.end()) {
+        translate = Vector(node["translate"]);
+    }
+
 // =============================================================================
 // -- Determine type and parse object parameters ------------------------------
 // =============================================================================
 
     if (node["type"] == "sphere") {
-        Point pos(node["position"]);
+        Point pos = Point(node["position"]) + translate;
         double radius = node["radius"];
         if (node.find("rotation") != node.end() && node.find("angle") != node.end()) {
             Vector rotation(node["rotation"]);
@@ -42,31 +57,47 @@ bool Raytracer::parseObjectNode(json const &node) {
             obj = ObjectPtr(new Sphere(pos, radius));
         }
     } else if (node["type"] == "triangle") {
-        Point a(node["a"]),
-                b(node["b"]),
-                c(node["c"]);
+        Point a = Point(node["a"]) + translate,
+                b = Point(node["b"]) + translate,
+                c = Point(node["c"]) + translate;
         obj = ObjectPtr(new Triangle(a, b, c));
     } else if (node["type"] == "cone") {
-        Point C(node["C"]);
+        Point C = Point(node["C"]) + translate;
         Vector V(node["V"]);
         double theta(node["theta"]);
         obj = ObjectPtr(new Cone(C, V, theta));
     } else if (node["type"] == "cylinder") {
-        Point center(node["center"]);
+        Point center = Point(node["center"]) + translate;
         double radius(node["radius"]),
                 height(node["height"]);
         obj = ObjectPtr(new Cylinder(center, radius, height));
     } else if (node["type"] == "mesh") {
         string filepath = node["filepath"];
-        Mesh mesh(filepath);
-        for (Triangle const &triangle : mesh.getTriangles()) {
-            obj = ObjectPtr(new Triangle(triangle));
+        hashAsset(filepath);
+        shared_ptr<MeshObject> mesh_object;
+        if (assets) {
+            // A copy shares the triangles and BVH of the cached mesh
+            mesh_object = make_shared<MeshObject>(*assets->mesh(filepath, stats.times));
+        } else {
+            unique_ptr<Mesh> mesh;
+            {
+                ScopedTimer timer(stats.times.mesh_load);
+                mesh.reset(new Mesh(filepath));
+            }
+            ScopedTimer timer(stats.times.accel_build);
+            mesh_object = make_shared<MeshObject>(*mesh);
+        }
+        // Moves the rays instead of the triangles, so the BVH stays valid
+        mesh_object->translate(translate);
+        obj = mesh_object;
+        if (node.find("material") == node.end()) {
+            // Meshes without a material get a random color
             Color color((random() % 255) / 1000.0, (random() % 255) / 1000.0, (random() % 255) / 1000.0);
             Material material(color, 0.5, 0.6, 0.9, 64);
-            obj->material = material;
+            obj->material_id = scene.addMaterial(material);
             scene.addObject(obj);
+            return true;
         }
-        return true;
     } else {
         cerr << "Unknown object type: " << node["type"] << ".\n";
     }
@@ -79,18 +110,26 @@ bool Raytracer::parseObjectNode(json const &node) {
         return false;
 
     // Parse material and add object to the scene
-    obj->material = parseMaterialNode(node["material"]);
+    obj->material_id = scene.addMaterial(parseMaterialNode(node["material"]));
     scene.addObject(obj);
     return true;
 }
 
+void Raytracer::hashAsset(string const &filename) {
+    FileStamp stamp;
+    FileStamp::read(filename, stamp);   // a missing file keeps the default stamp
+    scene_hash = hashBytes(filename.data(), filename.size(), scene_hash);
+    scene_hash = hashBytes(&stamp.mtime, sizeof stamp.mtime, scene_hash);
+    scene_hash = hashBytes(&stamp.size, sizeof stamp.size, scene_hash);
+}
+
 Light Raytracer::parseLightNode(json const &node) const {
     Point pos(node["position"]);
     Color col(node["color"]);
     return Light(pos, col);
 }
 
-Material Raytracer::parseMaterialNode(json const &node) const {
+Material Raytracer::parseMaterialNode(json const &node) {
     Color color(0.5, 0.5, 0.5);
     if (node.find("color") != node.end()) {
         color = Color(node["color"]);
@@ -101,18 +140,48 @@ Material Raytracer::parseMaterialNode(json const &node) const {
     double n = node["n"];
     Material material(color, ka, kd, ks, n);
     if (node.find("texture") != node.end()) {
-        material.setTexture(node["texture"]);
+        hashAsset(Material::texturePath(node["texture"]));
+        if (assets) {
+            material.texture = assets->texture(Material::texturePath(node["texture"]), stats.times);
+        } else {
+            ScopedTimer timer(stats.times.texture_decode);
+            material.setTexture(node["texture"]);
+        }
     }
     return material;
 }
 
 bool Raytracer::readScene(string const &ifname)
 try {
+    Stopwatch read_watch;
+
     // Read and parse input json file
     ifstream infile(ifname);
     if (!infile) throw runtime_error("Could not open input file for reading.");
-    json jsonscene;
-    infile >> jsonscene;
+    // The text is kept for the hash that identifies the scene in checkpoints
+    string text((istreambuf_iterator<char>(infile)), istreambuf_iterator<char>());
+    json jsonscene = json::parse(text);
+    double read_seconds = read_watch.seconds();
+
+    bool ok = parseScene(move(jsonscene), hashBytes(text.data(), text.size()));
+    stats.times.scene_parse += read_seconds;
+    return ok;
+}
+catch (exception const &ex) {
+    cerr << ex.what() << '\n';
+    return false;
+}
+
+bool Raytracer::readSceneJson(json const &jsonscene) {
+    string text = jsonscene.dump();
+    return parseScene(jsonscene, hashBytes(text.data(), text.size()));
+}
+
+bool Raytracer::parseScene(json jsonscene, uint64_t scene_hash)
+try {
+    stats.times = PhaseTimes();
+    Stopwatch parse_watch;
+    this->scene_hash = scene_hash;
 
 // =============================================================================
 // -- Read your scene data in this section -------------------------------------
@@ -129,9 +198,50 @@ try {
     if (jsonscene.find("SuperSamplingFactor") != jsonscene.end()) {
         scene.setSsFactor(jsonscene["SuperSamplingFactor"]);
     }
+    if (jsonscene.find("SamplePattern") != jsonscene.end()) {
+        Sampler::Pattern pattern;
+        if (!Sampler::parsePattern(jsonscene["SamplePattern"], pattern))
+            throw runtime_error("SamplePattern must be \"regular\", \"jittered\", \"sobol\" or \"r2\".");
+        scene.setSamplePattern(pattern);
+    }
+    if (jsonscene.find("TextureFilter") != jsonscene.end()) {
+        Texture::Filter filter;
+        if (!Texture::parseFilter(jsonscene["TextureFilter"], filter))
+            throw runtime_error("TextureFilter must be \"nearest\", \"bilinear\" or \"trilinear\".");
+        scene.setTextureFilter(filter);
+    }
+    if (jsonscene.find("AdaptiveThreshold") != jsonscene.end()) {
+        // SuperSamplingFactor becomes the cap, used only where neighbours differ by more than this
+        scene.setAdaptiveThreshold(jsonscene["AdaptiveThreshold"]);
+    }
+    if (jsonscene.find("TimeBudget") != jsonscene.end()) {
+        // seconds, turns on progressive rendering
+        scene.setTimeBudget(jsonscene["TimeBudget"]);
+    }
+    if (jsonscene.find("ProgressInterval") != jsonscene.end()) {
+        scene.setProgressInterval(jsonscene["ProgressInterval"]);
+    }
+    if (jsonscene.find("CheckpointInterval") != jsonscene.end()) {
+        checkpoint_interval = jsonscene["CheckpointInterval"];
+    }
     if (jsonscene.find("MaxRecursionDepth") != jsonscene.end()) {
         scene.setRecursionDepth(jsonscene["MaxRecursionDepth"]);
     }
+    if (jsonscene.find("Threads") != jsonscene.end()) {
+        scene.setThreads(jsonscene["Threads"]);
+    }
+    if (jsonscene.find("Width") != jsonscene.end() || jsonscene.find("Height") != jsonscene.end()) {
+        unsigned width = jsonscene.value("Width", 400U),
+                height = jsonscene.value("Height", 400U);
+        if (width == 0 || height == 0) throw runtime_error("Width and Height must be positive.");
+        scene.setResolution(width, height);
+    }
+    if (jsonscene.find("Crop") != jsonscene.end()) {
+        // [x0, y0, x1, y1] in pixels, (0, 0) is the top left corner
+        vector<unsigned> crop = jsonscene["Crop"];
+        if (crop.size() != 4) throw runtime_error("Crop needs four values: [x0, y0, x1, y1].");
+        scene.setCrop(Tile{crop[0], crop[1], crop[2], crop[3]});
+    }
 
     for (auto const &lightNode : jsonscene["Lights"])
         scene.addLight(parseLightNode(lightNode));
@@ -143,6 +253,14 @@ try {
 
     cout << "Parsed " << objCount << " objects.\n";
 
+    {
+        ScopedTimer timer(stats.times.accel_build);
+        scene.buildBVH();
+    }
+    // The phases above ran while parsing, keep them out of the parse time
+    stats.times.scene_parse = parse_watch.seconds() - stats.times.mesh_load - stats.times.texture_decode -
+                              stats.times.accel_build;
+
 // =============================================================================
 // -- End of scene data reading ------------------------------------------------
 // =============================================================================
@@ -154,12 +272,106 @@ catch (exception const &ex) {
     return false;
 }
 
-void Raytracer::renderToFile(string const &ofname) {
-    // TODO: the size may be a settings in your file
-    Image img(400, 400);
+void Raytracer::setAssetCache(AssetCache *cache) {
+    assets = cache;
+}
+
+void Raytracer::setThreads(unsigned threads) {
+    scene.setThreads(threads);
+}
+
+Scene const &Raytracer::getScene() const {
+    return scene;
+}
+
+RenderStats const &Raytracer::getStats() const {
+    return stats;
+}
+
+void Raytracer::setResolution(unsigned width, unsigned height) {
+    scene.setResolution(width, height);
+}
+
+void Raytracer::setCrop(Tile const &crop) {
+    scene.setCrop(crop);
+}
+
+void Raytracer::setCheckpoint(double interval, bool resume) {
+    if (interval > 0) {
+        checkpoint_interval = interval;
+    } else if (checkpoint_interval <= 0) {
+        checkpoint_interval = DEFAULT_CHECKPOINT_INTERVAL;
+    }
+    this->resume = resume;
+}
+
+void Raytracer::setTimeBudget(double seconds) {
+    scene.setTimeBudget(seconds);
+}
+
+void Raytracer::setProgressInterval(double seconds) {
+    scene.setProgressInterval(seconds);
+}
+
+bool Raytracer::prepareImage(Image &img) {
+    // Only the crop region is allocated and traced
+    Tile region = scene.region();
+    if (region.x0 >= region.x1 || region.y0 >= region.y1) {
+        cerr << "Error: the crop window lies outside the image.\n";
+        return false;
+    }
+    img = Image(region.x1 - region.x0, region.y1 - region.y0);
+    stats.width = img.width();
+    stats.height = img.height();
+    stats.threads = scene.getNumWorkers();
+    return true;
+}
+
+bool Raytracer::renderImage(Image &img) {
+    if (!prepareImage(img)) {
+        return false;
+    }
+    if (checkpoint_interval > 0) {
+        cerr << "Warning: CheckpointInterval is ignored, this render writes no checkpoint.\n";
+    }
+    ScopedTimer timer(stats.times.render);
+    stats.counters = scene.render(img);
+    return true;
+}
+
+bool Raytracer::renderToFile(string const &ofname) {
+    Image img;
+    if (!prepareImage(img)) {
+        return false;
+    }
+    Tile region = scene.region();
+    // Finished tiles go to <output>.checkpoint, which is deleted once the image is written
+    Checkpoint checkpoint;
+    bool checkpointing = checkpoint_interval > 0 || resume;
+    if (checkpointing) {
+        uint64_t config = scene.configHash() ^ scene_hash;
+        if (!checkpoint.open(ofname + ".checkpoint", config, region, resume, checkpoint_interval)) {
+            cerr << "Error: could not write the checkpoint " << ofname << ".checkpoint.\n";
+            return false;
+        }
+        if (resume) {
+            cout << "Resuming with " << checkpoint.numRestored() << " finished tiles.\n";
+        }
+    }
     cout << "Tracing...\n";
-    scene.render(img);
+    {
+        ScopedTimer timer(stats.times.render);
+        // Progressive renders overwrite the output file with the image so far now and then
+        stats.counters = scene.render(img, [&ofname](Image const &partial) {
+            partial.write_png(ofname);
+        }, checkpointing ? &checkpoint : nullptr);
+    }
     cout << "Writing image to " << ofname << "...\n";
-    img.write_png(ofname);
+    {
+        ScopedTimer timer(stats.times.png_encode);
+        img.write_png(ofname);
+    }
+    checkpoint.finish();
     cout << "Done.\n";
+    return true;
 }
@@ -1,11 +1,16 @@
 #ifndef RAYTRACER_H_
 #define RAYTRACER_H_
 
+#include "assetcache.h"
+#include "checkpoint.h"
 #include "scene.h"
+#include "stats.h"
 
 #include <string>
 
 // Forward declerations
+class Image;
+
 class Light;
 
 class Material;
@@ -14,20 +19,75 @@ class Material;
 
 class Raytracer {
     Scene scene;
+    RenderStats stats;
+    uint64_t scene_hash = 0;            // of the scene file and its assets, identifies it in checkpoints
+    double checkpoint_interval = 0;     // seconds between checkpoint flushes, 0: no checkpoint
+    bool resume = false;
+    AssetCache *assets = nullptr;       // shared with other jobs, nullptr: load everything here
+
+    static double constexpr DEFAULT_CHECKPOINT_INTERVAL = 30.0;
 
 public:
 
     bool readScene(std::string const &ifname);
 
-    void renderToFile(std::string const &ofname);
+    // reads a scene that is already parsed, e.g. a job of the render server
+    bool readSceneJson(nlohmann::json const &jsonscene);
+
+    // Take meshes and textures from cache (and leave new ones there) instead
+    // of loading them for this scene only; must be called before readScene
+    void setAssetCache(AssetCache *cache);
+
+    // false if the crop window does not overlap the frame
+    bool renderToFile(std::string const &ofname);
+
+    // Renders into img, which gets the size of the crop region, without
+    // writing it (no checkpoints or progressive images either); false if
+    // the crop window does not overlap the frame
+    bool renderImage(Image &img);
+
+    // overrides the "Threads" setting of the scene file, 0 uses all cores
+    void setThreads(unsigned threads);
+
+    // override the "Width"/"Height" and "Crop" settings of the scene file
+    void setResolution(unsigned width, unsigned height);
+
+    void setCrop(Tile const &crop);
+
+    // Write finished tiles to <output>.checkpoint, flushed every interval
+    // seconds (0 keeps the "CheckpointInterval" of the scene or 30 s); with
+    // resume the tiles of an earlier run of the same render are reused
+    void setCheckpoint(double interval, bool resume);
+
+    // override the "TimeBudget" and "ProgressInterval" settings (progressive rendering)
+    void setTimeBudget(double seconds);
+
+    void setProgressInterval(double seconds);
+
+    Scene const &getScene() const;
+
+    // counters and phase timings of the last readScene and renderToFile
+    RenderStats const &getStats() const;
 
 private:
 
+    // scene_hash identifies the scene in checkpoints; jsonscene is taken by
+    // value as looking up absent keys inserts them
+    bool parseScene(nlohmann::json jsonscene, uint64_t scene_hash);
+
+    // Allocates img for the crop region and fills in the size of the stats;
+    // false if the crop window does not overlap the frame
+    bool prepareImage(Image &img);
+
     bool parseObjectNode(nlohmann::json const &node);
 
+    // Mixes the path, size and modification time of a mesh or texture into
+    // scene_hash, so that a checkpoint is not resumed after the file changed
+    void hashAsset(std::string const &filename);
+
     Light parseLightNode(nlohmann::json const &node) const;
 
-    Material parseMaterialNode(nlohmann::json const &node) const;
+    Material parseMaterialNode(nlohmann::json const &node);
 };
 
 #endif
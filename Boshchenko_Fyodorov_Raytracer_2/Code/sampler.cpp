@@ -0,0 +1,110 @@
+#include "sampler.h"
+
+#include <cmath>
+#include <cstdint>
+
+using namespace std;
+
+namespace {
+
+// Integer hash with good avalanche (from the murmur3 finalizer)
+uint32_t mix(uint32_t h) {
+    h ^= h >> 16;
+    h *= 0x85ebca6bU;
+    h ^= h >> 13;
+    h *= 0xc2b2ae35U;
+    h ^= h >> 16;
+    return h;
+}
+
+uint32_t pixelSeed(unsigned px, unsigned py, uint32_t stream) {
+    return mix(px * 0x9e3779b9U ^ mix(py + 0x632be5abU * stream));
+}
+
+double toUnit(uint32_t bits) {
+    return bits * (1.0 / 4294967296.0);
+}
+
+// First two dimensions of the Sobol sequence: the bit reversal of the index
+// and the generator matrix of the polynomial x + 1
+void sobol(uint32_t index, uint32_t &x, uint32_t &y) {
+    x = 0;
+    y = 0;
+    uint32_t v = 1U << 31;
+    for (uint32_t bit = 0; index; index >>= 1, ++bit, v ^= v >> 1) {
+        if (index & 1) {
+            x ^= 1U << (31 - bit);
+            y ^= v;
+        }
+    }
+}
+
+}
+
+Sampler::Sampler(Pattern pattern, int factor)
+        :
+        pattern(pattern),
+        factor(factor) {
+    // The same loops as before the patterns existed, so that REGULAR keeps its images
+    double step = 1.0 / factor;
+    double halved_step = step / 2;
+    for (double i = halved_step; i < 1; i += step) {
+        for (double j = halved_step; j < 1; j += step) {
+            grid.push_back(i);
+            grid.push_back(j);
+        }
+    }
+}
+
+unsigned Sampler::count() const {
+    return pattern == REGULAR ? static_cast<unsigned>(grid.size() / 2) : static_cast<unsigned>(factor * factor);
+}
+
+void Sampler::offset(unsigned px, unsigned py, unsigned index, double &i, double &j) const {
+    switch (pattern) {
+        case REGULAR:
+            i = grid[2 * index];
+            j = grid[2 * index + 1];
+            break;
+        case JITTERED: {
+            uint32_t seed = pixelSeed(px, py, index);
+            i = (index / factor + toUnit(mix(seed))) / factor;
+            j = (index % factor + toUnit(mix(seed ^ 0x68bc21ebU))) / factor;
+            break;
+        }
+        case SOBOL: {
+            // A random digital shift per pixel keeps the stratification of the sequence
+            uint32_t x, y;
+            sobol(index, x, y);
+            uint32_t seed = pixelSeed(px, py, 0);
+            i = toUnit(x ^ mix(seed));
+            j = toUnit(y ^ mix(seed ^ 0x68bc21ebU));
+            break;
+        }
+        case R2: {
+            // Roberts' sequence, rotated per pixel (Cranley-Patterson)
+            double const g = 1.32471795724474602596;   // the plastic number
+            uint32_t seed = pixelSeed(px, py, 0);
+            double a = toUnit(mix(seed)) + index / g,
+                    b = toUnit(mix(seed ^ 0x68bc21ebU)) + index / (g * g);
+            i = a - floor(a);
+            j = b - floor(b);
+            break;
+        }
+    }
+}
+
+bool Sampler::parsePattern(string const &name, Pattern &pattern) {
+    if (name == "regular") {
+        pattern = REGULAR;
+    } else if (name == "jittered") {
+        pattern = JITTERED;
+    } else if (name == "sobol") {
+        pattern = SOBOL;
+    } else if (name == "r2") {
+        pattern = R2;
+    } else {
+        return false;
+    }
+    return true;
+}
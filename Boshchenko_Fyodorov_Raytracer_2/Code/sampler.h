@@ -0,0 +1,40 @@
+#ifndef SAMPLER_H_
+#define SAMPLER_H_
+
+#include <string>
+#include <vector>
+
+/**
+ * Sub-pixel sample positions for anti-aliasing. A pixel gets factor x factor
+ * samples laid out by one of these patterns:
+ *   REGULAR   the centers of a factor x factor grid (the classic pattern)
+ *   JITTERED  one random position in every cell of that grid
+ *   SOBOL     the first samples of the 2D Sobol sequence
+ *   R2        the first samples of Roberts' R2 sequence
+ * The random patterns are scrambled with a seed derived from the pixel
+ * position in the frame, so an image does not depend on tiles, threads
+ * or the crop window, and neighbouring pixels do not share their errors.
+ */
+class Sampler {
+public:
+    enum Pattern {
+        REGULAR, JITTERED, SOBOL, R2
+    };
+
+    Sampler(Pattern pattern, int factor);
+
+    unsigned count() const;
+
+    // Position of sample 'index' < count() within pixel (px, py), in [0, 1)^2
+    void offset(unsigned px, unsigned py, unsigned index, double &i, double &j) const;
+
+    // Accepts "regular", "jittered", "sobol" and "r2"
+    static bool parsePattern(std::string const &name, Pattern &pattern);
+
+private:
+    Pattern pattern;
+    int factor;
+    std::vector<double> grid;   // i, j of the REGULAR samples
+};
+
+#endif
@@ -1,88 +1,115 @@
 #include <memory>
 
 #include "scene.h"
+#include "hash.h"
 #include "object.h"
 #include "image.h"
 
+#include <algorithm>
 #include <cmath>
 #include <iostream>
+#include <mutex>
+#include <thread>
 
 using namespace std;
 
-void makeDiffuse(Color &color, Color &material_color, Material material, Vector L, Vector N, LightPtr const &light) {
+void makeDiffuse(Color &color, Color const &material_color, Material const &material, Vector const &L,
+                 Vector const &N, LightPtr const &light) {
     double dot = L.dot(N);
     if (dot > 0) {
-        color += dot * material_color * light->color * material.kd;
+        color.addProduct(dot, material_color, light->color, material.kd);
     }
 }
 
-void makeSpecular(Color &color, Material material, Vector R, Vector V, LightPtr const &light) {
+void makeSpecular(Color &color, Material const &material, Vector const &R, Vector const &V,
+                  LightPtr const &light) {
     if (material.ks < Object::EPSILON) {
         return;
     }
     double dot = R.dot(V);
     if (dot > 0) {
-        color += pow(dot, material.n) * light->color * material.ks;
+        color.addScaled(pow(dot, material.n), light->color, material.ks);
     }
 }
 
-bool isShadowed(std::vector<ObjectPtr> &objects, Point hit, Vector L) {
-    for (auto const &object : objects) {
-        Ray ray(hit, L); // It is a ray from the hit point towards the light source.
-        Hit temp_hit(object->intersect(ray));
-        if (!isnan(temp_hit.t)) { // Check if there is an intersection.
+Object const *Scene::findHit(Ray const &ray, Hit &min_hit) const {
+    Object const *obj = nullptr;
+    for (Object const *object : unbounded_objects) {
+        Hit hit(object->intersect(ray));
+        if (hit.t < min_hit.t) {
+            min_hit = hit;
+            obj = object;
+        }
+    }
+    double t_max = min_hit.t;
+    bvh.traverse(ray, t_max, [&](unsigned first, unsigned, double &t_max) {
+        if (Object const *object = primitives.intersectLeaf(first, ray, min_hit)) {
+            obj = object;
+            t_max = min_hit.t;
+        }
+    });
+    return obj;
+}
+
+void Scene::findHits(RayPacket const &packet, PacketHit &hits) const {
+    for (Object const *object : unbounded_objects) {
+        object->intersectPacket(packet, packet.active, hits);
+    }
+    bvh.traversePacket(packet, hits.t, [&](unsigned first, unsigned, unsigned lanes) {
+        primitives.intersectLeafPacket(first, packet, lanes, hits);
+    });
+}
+
+bool Scene::isShadowed(Point const &hit, Vector const &L, double distance) const {
+    ++threadCounters().shadow_rays;
+    Ray ray(hit, L); // It is a ray from the hit point towards the light source.
+    // Any object in between will do, so stop at the first one instead of looking for the nearest.
+    for (Object const *object : unbounded_objects) {
+        if (object->occluded(ray, distance)) {
             return true;
         }
     }
-    return false;
+    return bvh.traverseAny(ray, distance, [&](unsigned first, unsigned) {
+        return primitives.occludedLeaf(first, ray, distance);
+    });
 }
 
-void calcReflection(Color &color, std::vector<ObjectPtr> const &objects, ObjectPtr &hit_object, Ray const &ray,
-                    Point &hit, Vector &N, int depth) {
-    if (depth == 0 || hit_object->material.ks < Object::EPSILON) {
+void Scene::calcReflection(Color &color, Object const *hit_object, Ray const &ray, Point const &hit,
+                           Vector const &N, int depth) const {
+    Material const &material = materials[hit_object->material_id];
+    if (depth == 0 || material.ks < Object::EPSILON) {
         return;
     }
-    Vector reflected = ray.D - 2 * ray.D.dot(N) * N;
+    Vector reflected = Vector::reflect(ray.D, N);
     Vector V = -ray.D;
 
+    Ray new_ray(hit, reflected);
+    ++threadCounters().reflection_rays;
     Hit min_hit(numeric_limits<double>::infinity(), Vector());
-    ObjectPtr reflected_object = nullptr;
-    Point hit_point;
-    for (ObjectPtr const &object : objects) {
-        Ray new_ray(hit, reflected);
-        Hit new_hit(object->intersect(new_ray));
-        if (new_hit.t < min_hit.t) {
-            reflected_object = object;
-            min_hit = new_hit;
-            hit_point = new_ray.at(new_hit.t);
-        }
-    }
+    Object const *reflected_object = findHit(new_ray, min_hit);
     if (!reflected_object) {
         return;
     }
-    color += pow(V.dot(V), hit_object->material.n) * reflected_object->material.color * hit_object->material.ks *
-             Object::DEFAULT_SHININESS;
-    calcReflection(color, objects, reflected_object, Ray(hit_point, reflected), hit_point, min_hit.N, depth - 1);
+    Point hit_point = new_ray.at(min_hit.t);
+    color.addScaled(pow(V.dot(V), material.n), materials[reflected_object->material_id].color, material.ks,
+                    Object::DEFAULT_SHININESS);
+    calcReflection(color, reflected_object, Ray(hit_point, reflected), hit_point, min_hit.N, depth - 1);
 }
 
-Color Scene::trace(Ray const &ray) {
+Color Scene::trace(Ray const &ray) const {
     // Find hit object and distance
     Hit min_hit(numeric_limits<double>::infinity(), Vector());
-    ObjectPtr obj = nullptr;
-    for (ObjectPtr const &object : objects) {
-        Hit hit(object->intersect(ray));
-        if (hit.t < min_hit.t) {
-            min_hit = hit;
-            obj = object;
-        }
-    }
+    Object const *obj = findHit(ray, min_hit);
 
     // No hit? Return background color.
     if (!obj) {
         return Color(0.0, 0.0, 0.0);
     }
+    return shade(ray, obj, min_hit);
+}
 
-    Material material = obj->material;             //the hit objects material
+Color Scene::shade(Ray const &ray, Object const *obj, Hit const &min_hit) const {
+    Material const &material = materials[obj->material_id];   //the hit objects material
     Point hit = ray.at(min_hit.t);                 //the hit point
     Vector N = min_hit.N;                          //the normal at hit point
     Vector V = -ray.D;                             //the view vector
@@ -105,57 +132,390 @@ Color Scene::trace(Ray const &ray) {
     *        pow(a,b)           a to the power of b
     ****************************************************/
     Color material_color;
-    if (material.has_texture) {
+    if (material.texture) {
+        ++threadCounters().texture_lookups;
         auto mapped_coord = obj->mapTextureCoord(hit);
-        material_color = material.texture.colorAt((float) mapped_coord.first, (float) mapped_coord.second);
+        if (texture_filter == Texture::NEAREST) {
+            material_color = material.texture->colorAt((float) mapped_coord.first, (float) mapped_coord.second);
+        } else {
+            float lod = texture_filter == Texture::TRILINEAR ?
+                        textureLod(obj, *material.texture, hit, N, min_hit.t, mapped_coord) : 0;
+            material_color = material.texture->sample((float) mapped_coord.first, (float) mapped_coord.second,
+                                                      texture_filter, lod);
+        }
     } else {
         material_color = material.color;
     }
     Color color = material_color * material.ka;              // Ambient
     for (LightPtr const &light : lights) {
-        Vector L = (light->position - hit).normalized(),    // Vector from the hit location to the light position.
-                R = 2 * N.dot(L) * N - L;                   // Reflected vector.
-        if (shadows && isShadowed(objects, hit, L)) {
+        Vector to_light = light->position - hit;
+        Vector L = to_light.normalized();                   // Vector from the hit location to the light position.
+        // Only objects between the hit and the light cast a shadow
+        if (shadows && isShadowed(hit, L, to_light.length())) {
             // No need for diffuse and specular reflections when we are in the shadow.
             continue;
         }
+        Vector R = -Vector::reflect(L, N);                  // Reflected vector: 2 * N.dot(L) * N - L
         makeDiffuse(color, material_color, material, L, N, light);
         makeSpecular(color, material, R, V, light);
-        calcReflection(color, objects, obj, ray, hit, N, recursion_depth);
+        calcReflection(color, obj, ray, hit, N, recursion_depth);
     }
     return color;
 }
 
-void Scene::render(Image &img) {
-    unsigned w = img.width();
-    unsigned h = img.height();
+float Scene::textureLod(Object const *obj, Texture const &texture, Point const &hit, Vector const &N, double t,
+                        pair<double, double> const &coord) const {
+    // The footprint of a pixel at distance t from the eye (for reflected rays t
+    // only counts the last segment, which makes their footprint smaller)
+    if (eye.z == 0) {
+        return 0;
+    }
+    double footprint = t * VIEW_SIZE / (height * ss_factor * fabs(eye.z));
+
+    // How the texture coordinates change across the footprint, in texels,
+    // along two directions of the tangent plane. They are measured over a
+    // small step, as a point stepped off a curved surface maps to other
+    // coordinates than the surface point next to it.
+    double const STEP = 1e-3;
+    Vector axis = fabs(N.x) < 0.9 ? Vector(1, 0, 0) : Vector(0, 1, 0);
+    Vector tangent = N.cross(axis).normalized();
+    Vector const directions[2] = {tangent, N.cross(tangent)};
+    double derivative[2][2];
+    for (int idx = 0; idx < 2; ++idx) {
+        auto other = obj->mapTextureCoord(hit + STEP * footprint * directions[idx]);
+        double du = other.first - coord.first,
+                dv = other.second - coord.second;
+        du -= round(du);        // u wraps around
+        // Near a pole there may be no coordinates
+        if (!isfinite(du) || !isfinite(dv)) {
+            return 0;
+        }
+        derivative[idx][0] = du * texture.width() / STEP;
+        derivative[idx][1] = dv * texture.height() / STEP;
+    }
+
+    // The footprint is an ellipse in the texture. Its major axis can be far
+    // longer than the minor one (towards the poles of a sphere, or at grazing
+    // angles), and filtering over the major axis would then blur in the other
+    // direction as well, so the level of detail follows the minor axis.
+    double sum = 0;
+    for (auto const &row : derivative) {
+        sum += row[0] * row[0] + row[1] * row[1];
+    }
+    double det = fabs(derivative[0][0] * derivative[1][1] - derivative[0][1] * derivative[1][0]);
+    double major = sqrt((sum + sqrt(max(0.0, sum * sum - 4 * det * det))) / 2);
+    double texels = major > 0 ? det / major : 0;
+    return texels > 1 ? static_cast<float>(log2(texels)) : 0.0f;
+}
+
+RenderCounters Scene::render(Image &img, function<void(Image const &)> const &progress, Checkpoint *checkpoint) const {
+    // Only the crop region is cut into tiles; they keep frame coordinates
+    Tile r = region();
+    vector<Tile> tiles;
+    for (unsigned y0 = r.y0; y0 < r.y1; y0 += TILE_SIZE) {
+        for (unsigned x0 = r.x0; x0 < r.x1; x0 += TILE_SIZE) {
+            tiles.push_back(Tile{x0, y0, min(x0 + TILE_SIZE, r.x1), min(y0 + TILE_SIZE, r.y1)});
+        }
+    }
+
+    if (time_budget > 0) {
+        return renderProgressive(img, tiles, progress);
+    }
+
+    // The last pass skips the tiles of an earlier run and logs the ones it finishes
+    Sampler sampler(sample_pattern, ss_factor);
+    auto final_pass = [&](vector<bool> const *refine) {
+        return renderTiles(tiles, [&](Tile const &tile) {
+            if (checkpoint && checkpoint->restored(tile)) {
+                return;
+            }
+            renderTile(img, tile, sampler, refine);
+            if (checkpoint) {
+                checkpoint->add(tile, img);
+            }
+        });
+    };
+    if (adaptive_threshold <= 0 || ss_factor <= 1) {
+        if (checkpoint) {
+            checkpoint->restore(img);
+        }
+        return final_pass(nullptr);
+    }
+
+    // A coarse pass with one ray through every pixel center (whatever the pattern, so that
+    // noise does not pass for contrast), then the full pattern where it shows contrast
+    Sampler coarse(Sampler::REGULAR, 1);
+    RenderCounters counters = renderTiles(tiles, [&](Tile const &tile) {
+        renderTile(img, tile, coarse, nullptr);
+    });
+    vector<bool> refine = contrastMask(img);
+    if (checkpoint) {
+        checkpoint->restore(img);
+    }
+    counters += final_pass(&refine);
+    return counters;
+}
+
+RenderCounters Scene::renderTiles(vector<Tile> const &tiles, function<void(Tile const &)> const &render_tile) const {
+    unsigned workers = min(getNumWorkers(), static_cast<unsigned>(tiles.size()));
+    if (workers <= 1) {
+        RenderCounters before = threadCounters();
+        threadCounters() = RenderCounters();
+        for (Tile const &tile : tiles) {
+            render_tile(tile);
+        }
+        RenderCounters counters = threadCounters();
+        threadCounters() = before;
+        return counters;
+    }
+
+    // Every pixel is written by exactly one tile, so the workers share the image without locking
+    TileQueue queue(tiles, workers);
+    RenderCounters counters;
+    mutex counters_mutex;
+    vector<thread> pool;
+    for (unsigned worker = 0; worker < workers; ++worker) {
+        pool.emplace_back([&render_tile, &queue, &counters, &counters_mutex, worker] {
+            Tile tile;
+            while (queue.pop(worker, tile)) {
+                render_tile(tile);
+            }
+            lock_guard<mutex> lock(counters_mutex);
+            counters += threadCounters();
+        });
+    }
+    for (thread &t : pool) {
+        t.join();
+    }
+    return counters;
+}
+
+vector<bool> Scene::contrastMask(Image const &img) const {
+    unsigned w = img.width(), h = img.height();
+    vector<bool> refine(img.size(), false);
+    auto differs = [&](unsigned x0, unsigned y0, unsigned x1, unsigned y1) {
+        Pixel const &a = img(x0, y0), &b = img(x1, y1);
+        return fabs(a.r - b.r) > adaptive_threshold || fabs(a.g - b.g) > adaptive_threshold ||
+               fabs(a.b - b.b) > adaptive_threshold;
+    };
+    // Both pixels of a contrasting pair are refined
     for (unsigned y = 0; y < h; ++y) {
         for (unsigned x = 0; x < w; ++x) {
-            Color color(0, 0, 0);
-
-            // Anti-aliasing
-            double step = 1.0 / ss_factor;
-            double halved_step = step / 2;
-            for (double i = halved_step; i < 1; i += step) {
-                for (double j = halved_step; j < 1; j += step) {
-                    Point pixel(x + i, h - 1 - y + j, 0);
-                    Ray ray(eye, (pixel - eye).normalized());
-                    color += trace(ray);
+            if (x + 1 < w && differs(x, y, x + 1, y)) {
+                refine[y * w + x] = refine[y * w + x + 1] = true;
+            }
+            if (y + 1 < h && differs(x, y, x, y + 1)) {
+                refine[y * w + x] = refine[(y + 1) * w + x] = true;
+            }
+        }
+    }
+    return refine;
+}
+
+uint64_t Scene::configHash() const {
+    // Only plain values, written one by one so that padding does not count
+    uint64_t h = hashBytes(&eye.x, sizeof(double));
+    h = hashBytes(&eye.y, sizeof(double), h);
+    h = hashBytes(&eye.z, sizeof(double), h);
+    h = hashBytes(&shadows, sizeof shadows, h);
+    h = hashBytes(&ss_factor, sizeof ss_factor, h);
+    h = hashBytes(&sample_pattern, sizeof sample_pattern, h);
+    h = hashBytes(&adaptive_threshold, sizeof adaptive_threshold, h);
+    h = hashBytes(&texture_filter, sizeof texture_filter, h);
+    h = hashBytes(&recursion_depth, sizeof recursion_depth, h);
+    h = hashBytes(&width, sizeof width, h);
+    return hashBytes(&height, sizeof height, h);
+}
+
+unsigned Scene::getNumWorkers() const {
+    return threads > 0 ? threads : max(1U, thread::hardware_concurrency());
+}
+
+Tile Scene::region() const {
+    return Tile{min(crop.x0, width), min(crop.y0, height), min(crop.x1, width), min(crop.y1, height)};
+}
+
+Ray Scene::primaryRay(unsigned px, unsigned py, double i, double j) const {
+    double scale = VIEW_SIZE / height;     // world units per pixel
+    Point pixel((px + i) * scale, (height - 1 - py + j) * scale, 0);
+    return Ray(eye, (pixel - eye).normalized());
+}
+
+template<typename Wanted, typename Done>
+void Scene::traceTile(Tile const &tile, Sampler const &sampler, unsigned first, unsigned last, Wanted &&wanted,
+                      Done &&done) const {
+    // The primary rays through the same sub-pixel position of a 2x2 block of
+    // pixels form a packet; shading then goes on ray by ray.
+    for (unsigned y = tile.y0; y < tile.y1; y += 2) {
+        for (unsigned x = tile.x0; x < tile.x1; x += 2) {
+            bool lane_wanted[RayPacket::SIZE];
+            bool any = false;
+            for (int lane = 0; lane < RayPacket::SIZE; ++lane) {
+                unsigned px = x + lane % 2, py = y + lane / 2;
+                lane_wanted[lane] = px < tile.x1 && py < tile.y1 && wanted(px, py);
+                any = any || lane_wanted[lane];
+            }
+            if (!any) {
+                continue;
+            }
+            Color colors[RayPacket::SIZE];
+
+            // Anti-aliasing: every pixel of the block takes its own sample number 'sample'
+            for (unsigned sample = first; sample < last; ++sample) {
+                RayPacket packet(eye);
+                for (int lane = 0; lane < RayPacket::SIZE; ++lane) {
+                    if (lane_wanted[lane]) {
+                        unsigned px = x + lane % 2, py = y + lane / 2;
+                        double i, j;
+                        sampler.offset(px, py, sample, i, j);
+                        packet.setLane(lane, primaryRay(px, py, i, j).D);
+                    }
+                }
+                packet.prepare();
+                threadCounters().primary_rays += __builtin_popcount(packet.active);
+
+                PacketHit hits;
+                findHits(packet, hits);
+                for (int lane = 0; lane < RayPacket::SIZE; ++lane) {
+                    if (hits.object[lane]) {
+                        colors[lane] += shade(packet.ray(lane), hits.object[lane],
+                                              Hit(hits.t[lane], hits.N[lane]));
+                    }
+                }
+            }
+
+            for (int lane = 0; lane < RayPacket::SIZE; ++lane) {
+                if (lane_wanted[lane]) {
+                    done(x + lane % 2, y + lane / 2, colors[lane]);
                 }
             }
-            color /= pow(ss_factor, 2);
-            color.clamp();
-            img(x, y) = color;
         }
     }
 }
 
+void Scene::renderTile(Image &img, Tile const &tile, Sampler const &sampler, vector<bool> const *refine) const {
+    Tile r = region();
+    unsigned w = r.x1 - r.x0;
+    traceTile(tile, sampler, 0, sampler.count(), [&](unsigned px, unsigned py) {
+        return !refine || (*refine)[(py - r.y0) * w + px - r.x0];
+    }, [&](unsigned px, unsigned py, Color const &sum) {
+        Color color = sum / sampler.count();
+        color.clamp();
+        img.put_pixel(px - r.x0, py - r.y0, color);
+    });
+}
+
+RenderCounters Scene::renderProgressive(Image &img, vector<Tile> const &tiles,
+                                        function<void(Image const &)> const &progress) const {
+    Tile r = region();
+    unsigned w = r.x1 - r.x0, h = r.y1 - r.y0;
+    vector<Color> sums(w * h);
+    vector<unsigned> counts(w * h, 0);
+    Sampler sampler(sample_pattern, ss_factor);
+    Stopwatch clock;
+    double next_progress = progress_interval;
+    RenderCounters counters;
+
+    // Pixels without a sample show the one of the coarser block they lie in
+    auto resolve = [&] {
+        for (unsigned y = 0; y < h; ++y) {
+            for (unsigned x = 0; x < w; ++x) {
+                unsigned idx = y * w + x;
+                if (counts[idx] > 0) {
+                    Color color = sums[idx] / counts[idx];
+                    color.clamp();
+                    img.put_pixel(x, y, color);
+                }
+            }
+        }
+        for (unsigned y = 0; y < h; ++y) {
+            for (unsigned x = 0; x < w; ++x) {
+                for (unsigned block = 2; counts[y * w + x] == 0 && block <= COARSE_BLOCK; block *= 2) {
+                    unsigned ox = x - x % block, oy = y - y % block;
+                    if (counts[oy * w + ox] > 0) {
+                        img(x, y) = img(ox, oy);
+                        break;
+                    }
+                }
+            }
+        }
+    };
+
+    // One pass adds sample number 'sample' to the pixels picked by wanted(x, y),
+    // in coordinates of the region; tiles that start after the budget ran out are skipped
+    auto pass = [&](unsigned sample, bool use_budget, auto const &wanted) {
+        counters += renderTiles(tiles, [&](Tile const &tile) {
+            if (use_budget && clock.seconds() >= time_budget) {
+                return;
+            }
+            traceTile(tile, sampler, sample, sample + 1, [&](unsigned px, unsigned py) {
+                return wanted(px - r.x0, py - r.y0);
+            }, [&](unsigned px, unsigned py, Color const &sum) {
+                unsigned idx = (py - r.y0) * w + px - r.x0;
+                sums[idx] += sum;
+                ++counts[idx];
+            });
+        });
+        if (progress && progress_interval > 0 && clock.seconds() >= next_progress) {
+            resolve();
+            progress(img);
+            next_progress = clock.seconds() + progress_interval;
+        }
+    };
+
+    // The first sample goes to one pixel per COARSE_BLOCK x COARSE_BLOCK block, always
+    // completed so that the whole image is covered, then to ever finer blocks
+    for (unsigned block = COARSE_BLOCK; block >= 1; block /= 2) {
+        pass(0, block < COARSE_BLOCK, [block](unsigned x, unsigned y) {
+            return x % block == 0 && y % block == 0 &&
+                   (block == COARSE_BLOCK || x % (2 * block) != 0 || y % (2 * block) != 0);
+        });
+    }
+    // Then one more sample for every pixel per pass, up to the whole pattern
+    for (unsigned sample = 1; sample < sampler.count() && clock.seconds() < time_budget; ++sample) {
+        pass(sample, true, [](unsigned, unsigned) {
+            return true;
+        });
+    }
+    resolve();
+    return counters;
+}
+
 // --- Misc functions ----------------------------------------------------------
 
 void Scene::addObject(ObjectPtr obj) {
     objects.push_back(obj);
 }
 
+unsigned Scene::addMaterial(Material const &material) {
+    materials.push_back(material);
+    return static_cast<unsigned>(materials.size() - 1);
+}
+
+void Scene::buildBVH() {
+    bounded_objects.clear();
+    unbounded_objects.clear();
+
+    vector<Object *> candidates;
+    vector<AABB> bounds;
+    for (ObjectPtr const &object : objects) {
+        AABB box = object->boundingBox();
+        if (box.isFinite()) {
+            candidates.push_back(object.get());
+            bounds.push_back(box);
+        } else {
+            unbounded_objects.push_back(object.get());
+        }
+    }
+
+    bvh.build(bounds);
+    // Store the objects in leaf order so that a leaf is a contiguous range
+    for (unsigned index : bvh.order()) {
+        bounded_objects.push_back(candidates[index]);
+    }
+    primitives.build(bounded_objects, bvh);
+}
+
 void Scene::addLight(Light const &light) {
     lights.push_back(std::make_shared<Light>(light));
 }
@@ -172,6 +532,39 @@ void Scene::setSsFactor(int ss_factor) {
     this->ss_factor = ss_factor;
 }
 
+void Scene::setTextureFilter(Texture::Filter filter) {
+    texture_filter = filter;
+}
+
+void Scene::setSamplePattern(Sampler::Pattern pattern) {
+    sample_pattern = pattern;
+}
+
+void Scene::setTimeBudget(double seconds) {
+    time_budget = seconds;
+}
+
+void Scene::setProgressInterval(double seconds) {
+    progress_interval = seconds;
+}
+
+void Scene::setAdaptiveThreshold(double threshold) {
+    adaptive_threshold = threshold;
+}
+
+void Scene::setThreads(unsigned threads) {
+    this->threads = threads;
+}
+
+void Scene::setResolution(unsigned width, unsigned height) {
+    this->width = width;
+    this->height = height;
+}
+
+void Scene::setCrop(Tile const &crop) {
+    this->crop = crop;
+}
+
 void Scene::setRecursionDepth(int recursion_depth) {
     this->recursion_depth = recursion_depth;
 }
@@ -183,3 +576,11 @@ unsigned Scene::getNumObject() {
 unsigned Scene::getNumLights() {
     return static_cast<unsigned int>(lights.size());
 }
+
+vector<LightPtr> const &Scene::getLights() const {
+    return lights;
+}
+
+Material const &Scene::getMaterial(unsigned material_id) const {
+    return materials[material_id];
+}
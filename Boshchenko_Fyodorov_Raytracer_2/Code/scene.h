@@ -1,10 +1,19 @@
 #ifndef SCENE_H_
 #define SCENE_H_
 
+#include "bvh.h"
+#include "checkpoint.h"
 #include "light.h"
+#include "material.h"
 #include "object.h"
+#include "primitives.h"
+#include "sampler.h"
+#include "stats.h"
+#include "texture.h"
+#include "tilequeue.h"
 #include "triple.h"
 
+#include <functional>
 #include <vector>
 
 // Forward declerations
@@ -14,22 +23,73 @@ class Image;
 
 class Scene {
     std::vector<ObjectPtr> objects;
+    std::vector<Object const *> bounded_objects;    // in BVH leaf order
+    std::vector<Object const *> unbounded_objects;  // tested against every ray
+    BVH bvh;
+    PrimitiveTable primitives;      // bounded_objects split by type per BVH leaf
     std::vector<LightPtr> lights;   // no ptr needed, but kept for consistency
+    std::vector<Material> materials;    // indexed by Object::material_id
     Point eye;
     bool shadows = false;
     int ss_factor = 1;
+    Sampler::Pattern sample_pattern = Sampler::REGULAR;    // ss_factor² samples per pixel
+    double adaptive_threshold = 0;  // > 0: ss_factor² rays only where the contrast exceeds it
+    Texture::Filter texture_filter = Texture::NEAREST;
+    double time_budget = 0;         // > 0: progressive rendering for at most this many seconds
+    double progress_interval = 0;   // seconds between intermediate images of progressive rendering
     int recursion_depth = 0;
+    unsigned threads = 0;           // 0: one per hardware thread
+    unsigned width = 400;           // size of the whole frame in pixels
+    unsigned height = 400;
+    Tile crop{0, 0, ~0U, ~0U};      // part of the frame to render, clipped by region()
+
+    static unsigned constexpr TILE_SIZE = 16;
+    static unsigned constexpr COARSE_BLOCK = 8;     // first pass of progressive rendering: 1 ray per 8x8 pixels
+    // The frame covers the view window [0, VIEW_SIZE * width / height] x [0, VIEW_SIZE]
+    // of the z = 0 plane, whatever the resolution
+    static double constexpr VIEW_SIZE = 400.0;
 
 public:
 
     // trace a ray into the scene and return the color
-    Color trace(Ray const &ray);
+    // (safe to call from several threads at once)
+    Color trace(Ray const &ray) const;
+
+    // nearest hit along the ray, nullptr if there is none
+    Object const *findHit(Ray const &ray, Hit &min_hit) const;
+
+    // Phong color (plus shadows and reflections) at the hit of a ray
+    Color shade(Ray const &ray, Object const *obj, Hit const &min_hit) const;
+
+    // render the crop region of the frame, img must have the size of region();
+    // returns the work counters of all threads that took part. A progressive
+    // render (see setTimeBudget) calls progress with the image so far every
+    // progress interval. Finished tiles are appended to checkpoint, and the
+    // tiles it restored are not traced again (not for progressive renders).
+    RenderCounters render(Image &img, std::function<void(Image const &)> const &progress = nullptr,
+                          Checkpoint *checkpoint = nullptr) const;
 
-    // render the scene to the given image
-    void render(Image &img);
+    // hash of the settings that change the rendered pixels (not of the objects)
+    uint64_t configHash() const;
+
+    // the primary ray through sub-pixel position (i, j) in [0, 1)^2 of pixel
+    // (px, py) of the frame, counted from the top left corner
+    Ray primaryRay(unsigned px, unsigned py, double i, double j) const;
+
+    // number of threads render() uses
+    unsigned getNumWorkers() const;
+
+    // the crop window clipped to the frame, in pixels of the whole frame
+    Tile region() const;
 
     void addObject(ObjectPtr obj);
 
+    // adds a material to the table and returns its material_id
+    unsigned addMaterial(Material const &material);
+
+    // (re)build the acceleration structure, must be called after the last addObject
+    void buildBVH();
+
     void addLight(Light const &light);
 
     void setEye(Triple const &position);
@@ -40,9 +100,77 @@ public:
 
     void setSsFactor(int ss_factor);
 
+    void setSamplePattern(Sampler::Pattern pattern);
+
+    // Progressive rendering: one ray per 8x8 block first, refined down to
+    // one ray per pixel and then sample by sample into an accumulation
+    // buffer, until all ss_factor² samples are in or the budget is spent.
+    // 0 turns it off.
+    void setTimeBudget(double seconds);
+
+    void setProgressInterval(double seconds);
+
+    // Adaptive supersampling: every pixel first gets one ray through its
+    // center, and only pixels that differ from a neighbour by more than
+    // threshold in any channel get all ss_factor x ss_factor samples
+    void setAdaptiveThreshold(double threshold);
+
+    // How textures are sampled: NEAREST (the default) reads one texel,
+    // BILINEAR interpolates four, and TRILINEAR also picks a mip level from
+    // the footprint of a sample at the hit, so distant textures do not alias
+    void setTextureFilter(Texture::Filter filter);
+
+    void setThreads(unsigned threads);
+
+    void setResolution(unsigned width, unsigned height);
+
+    void setCrop(Tile const &crop);
+
     unsigned getNumObject();
 
     unsigned getNumLights();
+
+    std::vector<LightPtr> const &getLights() const;
+
+    Material const &getMaterial(unsigned material_id) const;
+
+private:
+
+    // nearest hit for every lane of a packet of primary rays
+    void findHits(RayPacket const &packet, PacketHit &hits) const;
+
+    // whether any object blocks the ray from hit along L within distance
+    bool isShadowed(Point const &hit, Vector const &L, double distance) const;
+
+    void calcReflection(Color &color, Object const *hit_object, Ray const &ray, Point const &hit, Vector const &N,
+                        int depth) const;
+
+    // Traces the pixels of a tile with the samples of sampler; with a
+    // refine mask (one flag per pixel of region()) only the flagged ones
+    void renderTile(Image &img, Tile const &tile, Sampler const &sampler, std::vector<bool> const *refine) const;
+
+    // Traces samples [first, last) of sampler for the pixels of a tile for
+    // which wanted(px, py) holds and passes done(px, py, sum of the colors)
+    template<typename Wanted, typename Done>
+    void traceTile(Tile const &tile, Sampler const &sampler, unsigned first, unsigned last, Wanted &&wanted,
+                   Done &&done) const;
+
+    RenderCounters renderProgressive(Image &img, std::vector<Tile> const &tiles,
+                                     std::function<void(Image const &)> const &progress) const;
+
+    // Runs render_tile for every tile on getNumWorkers() threads and
+    // returns the counters of all of them
+    RenderCounters renderTiles(std::vector<Tile> const &tiles,
+                               std::function<void(Tile const &)> const &render_tile) const;
+
+    // Level of detail of a texture lookup at the hit at distance t: the
+    // spacing of the samples, widened with the distance and mapped to texels
+    // by the texture coordinates around the hit, along the minor axis
+    float textureLod(Object const *obj, Texture const &texture, Point const &hit, Vector const &N, double t,
+                     std::pair<double, double> const &coord) const;
+
+    // Flags the pixels of img that differ from a neighbour by more than adaptive_threshold
+    std::vector<bool> contrastMask(Image const &img) const;
 };
 
 #endif
@@ -0,0 +1,198 @@
+#include "server.h"
+#include "raytracer.h"
+
+#include "json/json.h"
+
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+
+using namespace std;
+using json = nlohmann::json;
+
+namespace {
+
+bool blank(string const &line) {
+    return line.find_first_not_of(" \t\r") == string::npos;
+}
+
+bool sendAll(int fd, string const &data) {
+    for (size_t sent = 0; sent < data.size();) {
+        ssize_t count = send(fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+        if (count < 0 && errno == EINTR) {
+            continue;
+        }
+        if (count <= 0) {
+            return false;
+        }
+        sent += static_cast<size_t>(count);
+    }
+    return true;
+}
+
+}
+
+RenderServer::RenderServer(int threads)
+        :
+        threads(threads) {}
+
+string RenderServer::handle(string const &line)
+try {
+    Stopwatch watch;
+    json job = json::parse(line);
+    if (!job.is_object() || job.find("scene") == job.end()) {
+        throw runtime_error("A job needs a \"scene\".");
+    }
+
+    json scene;
+    string output;
+    if (job["scene"].is_string()) {
+        string path = job["scene"];
+        ifstream infile(path);
+        if (!infile) throw runtime_error("Could not open " + path + " for reading.");
+        scene = json::parse(infile);
+        output = path.substr(0, path.find_last_of('.')) + ".png";
+    } else {
+        scene = job["scene"];
+    }
+    if (job.find("output") != job.end()) {
+        output = job["output"];
+    }
+    if (output.empty()) throw runtime_error("A job with an inline scene needs an \"output\".");
+
+    // The job overrides the scene, and the command line only the scene
+    if (threads >= 0) {
+        scene["Threads"] = threads;
+    }
+    for (auto entry = job.begin(); entry != job.end(); ++entry) {
+        if (entry.key() != "scene" && entry.key() != "output" && entry.key() != "stats") {
+            scene[entry.key()] = entry.value();
+        }
+    }
+
+    // Meshes without a material get a random color; with the seed of a
+    // fresh process a job gives the same image as a run of ray
+    srandom(1);
+    AssetCache::Counts before = assets.getCounts();
+    Raytracer raytracer;
+    raytracer.setAssetCache(&assets);
+    if (!raytracer.readSceneJson(scene)) throw runtime_error("Reading the scene failed.");
+    if (!raytracer.renderToFile(output)) throw runtime_error("Rendering failed.");
+    if (job.find("stats") != job.end() && !raytracer.getStats().writeJson(job["stats"])) {
+        throw runtime_error("Could not write the statistics.");
+    }
+
+    PhaseTimes const &times = raytracer.getStats().times;
+    AssetCache::Counts const &after = assets.getCounts();
+    json seconds = {
+            {"load",       times.scene_parse + times.mesh_load + times.texture_decode + times.accel_build},
+            {"render",     times.render},
+            {"png_encode", times.png_encode},
+            {"total",      watch.seconds()}
+    };
+    json cache = {
+            {"hits",   after.hits - before.hits},
+            {"misses", after.misses - before.misses}
+    };
+
+    json reply;
+    reply["ok"] = true;
+    reply["output"] = output;
+    reply["seconds"] = seconds;
+    reply["cache"] = cache;
+    return reply.dump();
+}
+catch (exception const &ex) {
+    json reply = {
+            {"ok",    false},
+            {"error", ex.what()}
+    };
+    return reply.dump();
+}
+
+void RenderServer::serve(istream &in, ostream &out) {
+    string line;
+    while (getline(in, line)) {
+        if (!blank(line)) {
+            out << handle(line) << endl;
+        }
+    }
+}
+
+bool RenderServer::serveSocket(string const &path) {
+    sockaddr_un address;
+    memset(&address, 0, sizeof address);
+    address.sun_family = AF_UNIX;
+    if (path.size() >= sizeof address.sun_path) {
+        cerr << "Error: the socket path " << path << " is too long.\n";
+        return false;
+    }
+    memcpy(address.sun_path, path.c_str(), path.size());
+
+    // A socket left behind by an earlier server is replaced, any other file is left alone
+    struct stat info;
+    if (lstat(path.c_str(), &info) == 0) {
+        if (!S_ISSOCK(info.st_mode)) {
+            cerr << "Error: " << path << " exists and is not a socket.\n";
+            return false;
+        }
+        unlink(path.c_str());
+    }
+    int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listener < 0 || bind(listener, reinterpret_cast<sockaddr *>(&address), sizeof address) != 0 ||
+        listen(listener, 8) != 0) {
+        cerr << "Error: could not listen on " << path << ": " << strerror(errno) << ".\n";
+        if (listener >= 0) {
+            close(listener);
+        }
+        return false;
+    }
+    cout << "Listening on " << path << ".\n";
+
+    // One connection at a time, a render uses all the threads anyway
+    for (;;) {
+        int connection = accept(listener, nullptr, nullptr);
+        if (connection < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            cerr << "Error: accept failed: " << strerror(errno) << ".\n";
+            close(listener);
+            return false;
+        }
+        string pending;
+        char chunk[4096];
+        bool open = true;
+        while (open) {
+            ssize_t count = read(connection, chunk, sizeof chunk);
+            if (count < 0 && errno == EINTR) {
+                continue;
+            }
+            if (count <= 0) {
+                // A last job without newline still counts
+                if (!blank(pending)) {
+                    sendAll(connection, handle(pending) + '\n');
+                }
+                break;
+            }
+            pending.append(chunk, static_cast<size_t>(count));
+            size_t end;
+            while (open && (end = pending.find('\n')) != string::npos) {
+                string line = pending.substr(0, end);
+                pending.erase(0, end + 1);
+                if (!blank(line)) {
+                    open = sendAll(connection, handle(line) + '\n');
+                }
+            }
+        }
+        close(connection);
+    }
+}
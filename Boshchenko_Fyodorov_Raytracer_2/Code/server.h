@@ -0,0 +1,45 @@
+#ifndef SERVER_H_
+#define SERVER_H_
+
+#include "assetcache.h"
+
+#include <iosfwd>
+#include <string>
+
+/**
+ * Renders one job after another in a single process, so that meshes, their
+ * BVHs and decoded textures are loaded once (see AssetCache) instead of once
+ * per run of ray. A job is one line of json:
+ *
+ *   {"scene": "../Scenes/scene01.json", "output": "out.png", "Eye": [200, 200, 1000],
+ *    "Width": 800, "Height": 800, "SuperSamplingFactor": 2}
+ *
+ * "scene" is the path of a scene file or a scene object inline. "output"
+ * defaults to the scene path with .png, and "stats" names a file for the
+ * report of --stats. Every other key overrides the scene parameter of the
+ * same name. Each job gets a reply line:
+ *
+ *   {"ok": true, "output": "out.png", "seconds": {...}, "cache": {"hits": 2, "misses": 0}}
+ *   {"ok": false, "error": "..."}
+ */
+class RenderServer {
+public:
+    // threads >= 0 is the default "Threads" of every job
+    explicit RenderServer(int threads = -1);
+
+    // Serves the jobs read from in until it ends, replies go to out
+    void serve(std::istream &in, std::ostream &out);
+
+    // Listens on a Unix socket at path and serves its connections one after
+    // another; only returns (false) if the socket cannot be set up
+    bool serveSocket(std::string const &path);
+
+    // Runs the job of one line and returns the reply, without newline
+    std::string handle(std::string const &line);
+
+private:
+    AssetCache assets;
+    int threads;
+};
+
+#endif
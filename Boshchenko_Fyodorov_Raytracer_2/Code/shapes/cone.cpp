@@ -1,11 +1,13 @@
 #include <cmath>
 #include "cone.h"
+#include "../stats.h"
 
 double cosd(double radians) {
     return cos(fmod((radians), 360) * M_PI / 180);
 }
 
-Hit Cone::intersect(Ray const &ray) {
+Hit Cone::intersect(Ray const &ray) const {
+    ++threadCounters().cone_tests;
     Vector CO = ray.O - C;
     double a = pow(ray.D.dot(V), 2) - pow(cosd(theta), 2),
             b = 2 * (ray.D.dot(V) * CO.dot(V) - ray.D.dot(CO) * pow(cosd(theta), 2)),
@@ -36,4 +38,8 @@ Hit Cone::getHit(const Ray &ray, double t) const {
     return Hit(t, P.normalized());
 }
 
+AABB Cone::boundingBox() const {
+    return AABB::infinite();
+}
+
 Cone::Cone(Point const &C, Vector const &V, double theta) : C(C), V(V), theta(theta) {}
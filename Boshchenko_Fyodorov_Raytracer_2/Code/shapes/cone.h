@@ -9,7 +9,10 @@ public:
 
     Hit getHit(const Ray &ray, double t) const;
 
-    virtual Hit intersect(Ray const &ray);
+    virtual Hit intersect(Ray const &ray) const;
+
+    // The cone is not capped, so it has no finite bounds.
+    virtual AABB boundingBox() const;
 
     Point C;
     Vector V;
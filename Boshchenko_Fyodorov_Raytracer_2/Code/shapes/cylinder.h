@@ -11,7 +11,14 @@ class Cylinder : public Object {
 public:
     Cylinder(Point const &center, double radius, double height);
 
-    Hit intersect(Ray const &ray);
+    Hit intersect(Ray const &ray) const;
+
+    bool occluded(Ray const &ray, double t_max) const;
+
+    // distance to the hit in front of the ray origin, NaN if there is none
+    double distance(Ray const &ray) const;
+
+    AABB boundingBox() const;
 
     Point center;
     double radius, height;
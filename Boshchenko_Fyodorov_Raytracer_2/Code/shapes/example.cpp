@@ -1,6 +1,6 @@
 #include "example.h"
 
-Hit Example::intersect(Ray const &ray) {
+Hit Example::intersect(Ray const &ray) const {
     /* Your intersect calculation goes here */
 
     double t = 0 /* = ... */;
@@ -7,7 +7,7 @@ class Example : public Object {
 public:
     Example(/* YOUR DATA MEMBERS HERE*/);
 
-    virtual Hit intersect(Ray const &ray);
+    virtual Hit intersect(Ray const &ray) const;
 
     /* YOUR DATA MEMBERS HERE*/
 };
@@ -0,0 +1,122 @@
+#include "meshobject.h"
+#include "triangle.h"
+#include "../stats.h"
+
+#include <cmath>
+#include <limits>
+
+MeshObject::MeshObject(Mesh const &mesh)
+        :
+        geometry(std::make_shared<Geometry const>(mesh)) {}
+
+MeshObject::Geometry::Geometry(Mesh const &mesh)
+        :
+        vertices(mesh.getVertices()),
+        bvh(mesh.getBVH() ? *mesh.getBVH() : mesh.buildBVH()) {
+    std::vector<unsigned> const &mesh_indices = mesh.getIndices();
+
+    // Store the triangles in leaf order so that a leaf is a contiguous range
+    indices.reserve(mesh_indices.size());
+    for (unsigned triangle : bvh.order()) {
+        indices.push_back(mesh_indices[3 * triangle]);
+        indices.push_back(mesh_indices[3 * triangle + 1]);
+        indices.push_back(mesh_indices[3 * triangle + 2]);
+    }
+
+    leaf_blocks.resize(mesh.numTriangles());
+    for (BVH::Node const &node : bvh.getNodes()) {
+        if (node.count == 0) {
+            continue;
+        }
+        leaf_blocks[node.first] = static_cast<unsigned>(blocks.size());
+        for (unsigned pos = node.first; pos < node.first + node.count; ++pos) {
+            if (pos == node.first || blocks.back().count == TriangleBlock::WIDTH) {
+                blocks.emplace_back();
+            }
+            blocks.back().add(Point(vertices[indices[3 * pos]]), Point(vertices[indices[3 * pos + 1]]),
+                              Point(vertices[indices[3 * pos + 2]]), pos);
+        }
+    }
+}
+
+Hit MeshObject::intersect(Ray const &ray) const {
+    Geometry const &mesh = *geometry;
+    Ray local(ray.O - offset, ray.D);
+    TriangleBlockKernel kernel = triangleBlockKernel();
+    RenderCounters &counters = threadCounters();
+    double t_max = std::numeric_limits<double>::infinity();
+    bool found = false;
+    mesh.bvh.traverse(local, t_max, [&](unsigned first, unsigned count, double &t_max) {
+        unsigned end = mesh.leaf_blocks[first] + (count + TriangleBlock::WIDTH - 1) / TriangleBlock::WIDTH;
+        for (unsigned index = mesh.leaf_blocks[first]; index < end; ++index) {
+            TriangleBlock const &block = mesh.blocks[index];
+            unsigned candidates = kernel(block, BlockRay(block, local, t_max));
+            counters.triangle_block_tests += 1;
+            counters.mesh_triangle_tests += __builtin_popcount(candidates);
+            // Only candidates get the exact test, in the same order as without blocks
+            for (unsigned lane = 0; candidates != 0; ++lane, candidates >>= 1) {
+                if ((candidates & 1U) == 0) {
+                    continue;
+                }
+                unsigned pos = block.triangle[lane];
+                double t = Triangle::distance(Point(mesh.vertices[mesh.indices[3 * pos]]),
+                                              Point(mesh.vertices[mesh.indices[3 * pos + 1]]),
+                                              Point(mesh.vertices[mesh.indices[3 * pos + 2]]), local);
+                if (t < t_max) {
+                    t_max = t;
+                    found = true;
+                }
+            }
+        }
+    });
+    if (!found) {
+        return Hit::NO_HIT();
+    }
+    Point hit = ray.O + t_max * ray.D;
+    Vector N = hit.normalized();    // same normal as Triangle::intersect
+    return Hit(t_max, N);
+}
+
+bool MeshObject::occluded(Ray const &ray, double t_max) const {
+    Geometry const &mesh = *geometry;
+    Ray local(ray.O - offset, ray.D);
+    TriangleBlockKernel kernel = triangleBlockKernel();
+    RenderCounters &counters = threadCounters();
+    return mesh.bvh.traverseAny(local, t_max, [&](unsigned first, unsigned count) {
+        unsigned end = mesh.leaf_blocks[first] + (count + TriangleBlock::WIDTH - 1) / TriangleBlock::WIDTH;
+        for (unsigned index = mesh.leaf_blocks[first]; index < end; ++index) {
+            TriangleBlock const &block = mesh.blocks[index];
+            unsigned candidates = kernel(block, BlockRay(block, local, t_max));
+            counters.triangle_block_tests += 1;
+            counters.mesh_triangle_tests += __builtin_popcount(candidates);
+            for (unsigned lane = 0; candidates != 0; ++lane, candidates >>= 1) {
+                if ((candidates & 1U) == 0) {
+                    continue;
+                }
+                unsigned pos = block.triangle[lane];
+                if (Triangle::distance(Point(mesh.vertices[mesh.indices[3 * pos]]),
+                                       Point(mesh.vertices[mesh.indices[3 * pos + 1]]),
+                                       Point(mesh.vertices[mesh.indices[3 * pos + 2]]), local) < t_max) {
+                    return true;
+                }
+            }
+        }
+        return false;
+    });
+}
+
+AABB MeshObject::boundingBox() const {
+    if (geometry->bvh.empty()) {
+        return AABB();
+    }
+    AABB box = geometry->bvh.getNodes()[0].box;
+    return AABB(box.min + offset, box.max + offset);
+}
+
+unsigned MeshObject::numTriangles() const {
+    return static_cast<unsigned>(geometry->indices.size() / 3);
+}
+
+void MeshObject::translate(Vector const &by) {
+    offset += by;
+}
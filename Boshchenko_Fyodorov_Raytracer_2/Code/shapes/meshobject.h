@@ -0,0 +1,52 @@
+#ifndef RAY_MESHOBJECT_H
+#define RAY_MESHOBJECT_H
+
+#include "../bvh.h"
+#include "../mesh.h"
+#include "../object.h"
+#include "../triangleblock.h"
+
+#include <memory>
+#include <vector>
+
+/**
+ * A whole triangle mesh as one scene object. The triangles are kept as
+ * indices into a shared vertex array and are found through a bottom-level
+ * BVH, so the scene BVH only sees a single entry with a single material.
+ * Every leaf of that BVH is also stored as SIMD triangle blocks which filter
+ * the triangles before the exact test. That data is immutable once built
+ * and shared by copies of the object, so a cached mesh can be put into
+ * another scene (with another material) without building it again. A copy
+ * can also be moved (translate), which offsets the rays instead of the
+ * shared triangles.
+ */
+class MeshObject : public Object {
+public:
+    explicit MeshObject(Mesh const &mesh);
+
+    virtual Hit intersect(Ray const &ray) const;
+
+    virtual bool occluded(Ray const &ray, double t_max) const;
+
+    virtual AABB boundingBox() const;
+
+    unsigned numTriangles() const;
+
+    void translate(Vector const &by);
+
+private:
+    struct Geometry {
+        std::vector<Pointf> vertices;
+        std::vector<unsigned> indices;  // 3 per triangle, in BVH leaf order
+        BVH bvh;
+        std::vector<TriangleBlock> blocks;
+        std::vector<unsigned> leaf_blocks;  // first block of the leaf starting at a position
+
+        explicit Geometry(Mesh const &mesh);
+    };
+
+    std::shared_ptr<Geometry const> geometry;
+    Vector offset{0, 0, 0};     // of this copy against the shared geometry
+};
+
+#endif //RAY_MESHOBJECT_H
@@ -1,45 +1,44 @@
 #include "sphere.h"
+#include "../primitives.h"
+#include "../stats.h"
 
 #include <cmath>
+#include <limits>
 
 using namespace std;
 
-Hit Sphere::intersect(Ray const &ray) {
-    Vector L = ray.O - center; // Direction from the sphere  center towards the origin of the ray
-    double a = ray.D.dot(ray.D),
-            b = 2 * ray.D.dot(L),
-            c = L.dot(L) - radius * radius;
-    double delta = b * b - 4 * a * c;
-    if (delta < 0) {
+Hit Sphere::intersect(Ray const &ray) const {
+    double t = distance(ray);
+    if (isnan(t)) {
         return Hit::NO_HIT();
     }
-    double t1 = (-b - sqrt(delta)) / (2.0 * a),
-            t2 = (-b + sqrt(delta)) / (2.0 * a);
-    if (t1 < 0 && t2 < 0) {
-        return Hit::NO_HIT();
-    }
-    double t;
-    if (t1 < 0) {
-        t = t2;
-    } else if (t2 < 0) {
-        t = t1;
-    } else {
-        t = min(t1, t2);
-    }
-    if (t < EPSILON) {
-        // Without such check, there will be a grainy picture because of a floating-point accuracy problem.
-        return Hit::NO_HIT();
-    }
-    Point hit = ray.at(t);
-    Vector N = (hit - center).normalized();
-    return Hit(t, N);
+    return Hit(t, sphereNormal(center, ray, t));
+}
+
+bool Sphere::occluded(Ray const &ray, double t_max) const {
+    return distance(ray) < t_max;
+}
+
+double Sphere::distance(Ray const &ray) const {
+    ++threadCounters().sphere_tests;
+    return sphereDistance(center, radius, ray);
+}
+
+void Sphere::intersectPacket(RayPacket const &packet, unsigned lanes, PacketHit &hits) const {
+    threadCounters().sphere_tests += __builtin_popcount(lanes);
+    spherePacket(center, radius, packet, lanes, hits, this);
+}
+
+AABB Sphere::boundingBox() const {
+    Vector extent(radius, radius, radius);
+    return AABB(center - extent, center + extent);
 }
 
-double Sphere::degToRad(int degrees) {
+double Sphere::degToRad(int degrees) const {
     return degrees * M_PI / 180;
 }
 
-Point Sphere::rotatedPoint(Point const &surface_point) {
+Point Sphere::rotatedPoint(Point const &surface_point) const {
     Vector vector_to_surface = surface_point - center;
     // Rodrigues' rotation is applied.
     Vector rotated_vector = vector_to_surface * cos(angle_rad) +
@@ -49,7 +48,7 @@ Point Sphere::rotatedPoint(Point const &surface_point) {
     return rotated_point;
 }
 
-std::pair<double, double> Sphere::mapTextureCoord(Point &surface_point) {
+std::pair<double, double> Sphere::mapTextureCoord(Point const &surface_point) const {
     Point rotated_point = is_rotated ? rotatedPoint(surface_point) : surface_point;
 
     double theta = acos((rotated_point.z - center.z) / radius),
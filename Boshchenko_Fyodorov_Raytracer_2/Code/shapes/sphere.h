@@ -9,13 +9,22 @@ public:
 
     Sphere(Point const &pos, double radius, Vector const &rotation, int angle);
 
-    virtual Hit intersect(Ray const &ray);
+    virtual Hit intersect(Ray const &ray) const;
 
-    double degToRad(int degrees);
+    virtual bool occluded(Ray const &ray, double t_max) const;
 
-    Point rotatedPoint(Point const &surface_point);
+    virtual void intersectPacket(RayPacket const &packet, unsigned lanes, PacketHit &hits) const;
 
-    virtual std::pair<double, double> mapTextureCoord(Point &surface_point);
+    virtual AABB boundingBox() const;
+
+    // distance to the nearest hit in front of the ray origin, NaN if there is none
+    double distance(Ray const &ray) const;
+
+    double degToRad(int degrees) const;
+
+    Point rotatedPoint(Point const &surface_point) const;
+
+    virtual std::pair<double, double> mapTextureCoord(Point const &surface_point) const;
 
     bool is_rotated = false;
     Point const center;
@@ -1,33 +1,39 @@
 #include "triangle.h"
+#include "../primitives.h"
+#include "../stats.h"
 
-Hit Triangle::intersect(Ray const &ray) {
-    Vector ab = b - a, ac = c - a;
-    Vector pvec = ray.D.cross(ac);
-    double determinant = ab.dot(pvec);
-    if (determinant > -EPSILON && determinant < EPSILON) {
-        return Hit::NO_HIT();
-    }
+#include <cmath>
+#include <limits>
 
-    double invDeterminant = 1.0 / determinant;
-    Vector tvec = ray.O - a;
-    double u = tvec.dot(pvec) * invDeterminant;
-    if (u < 0.0 || u > 1.0) {
+Hit Triangle::intersect(Ray const &ray) const {
+    ++threadCounters().triangle_tests;
+    double t = distance(a, b, c, ray);
+    if (std::isnan(t)) {
         return Hit::NO_HIT();
     }
+    return Hit(t, positionNormal(ray, t));
+}
 
-    Vector qvec = tvec.cross(ab);
-    double v = invDeterminant * ray.D.dot(qvec);
-    if (v < 0.0 || u + v > 1.0) {
-        return Hit::NO_HIT();
-    }
+void Triangle::intersectPacket(RayPacket const &packet, unsigned lanes, PacketHit &hits) const {
+    threadCounters().triangle_tests += __builtin_popcount(lanes);
+    trianglePacket(a, b, c, packet, lanes, hits, this);
+}
 
-    double t = invDeterminant * ac.dot(qvec);
-    if (t > EPSILON) {
-        Point hit = ray.O + t * ray.D;
-        Vector N = hit.normalized();
-        return Hit(t, N);
-    }
-    return Hit::NO_HIT();
+bool Triangle::occluded(Ray const &ray, double t_max) const {
+    ++threadCounters().triangle_tests;
+    return distance(a, b, c, ray) < t_max;
+}
+
+double Triangle::distance(Point const &a, Point const &b, Point const &c, Ray const &ray) {
+    return triangleDistance(a, b, c, ray);
+}
+
+AABB Triangle::boundingBox() const {
+    AABB box;
+    box.extend(a);
+    box.extend(b);
+    box.extend(c);
+    return box;
 }
 
 Triangle::Triangle(Point const &a, Point const &b, Point const &c) : a(a), b(b), c(c) {}
@@ -9,7 +9,17 @@ public:
 
     Triangle(Triangle const &another);
 
-    virtual Hit intersect(Ray const &ray);
+    virtual Hit intersect(Ray const &ray) const;
+
+    virtual bool occluded(Ray const &ray, double t_max) const;
+
+    virtual void intersectPacket(RayPacket const &packet, unsigned lanes, PacketHit &hits) const;
+
+    virtual AABB boundingBox() const;
+
+    // Möller–Trumbore test shared with MeshObject,
+    // returns the distance along the ray or NaN if there is no hit
+    static double distance(Point const &a, Point const &b, Point const &c, Ray const &ray);
 
     Point const a, b, c;
 };
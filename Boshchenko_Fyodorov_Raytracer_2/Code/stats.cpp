@@ -0,0 +1,67 @@
+#include "stats.h"
+
+#include "json/json.h"
+
+#include <fstream>
+#include <iomanip>
+
+using namespace std;
+using json = nlohmann::json;
+
+thread_local RenderCounters thread_counters;
+
+RenderCounters &RenderCounters::operator+=(RenderCounters const &other) {
+    primary_rays += other.primary_rays;
+    shadow_rays += other.shadow_rays;
+    reflection_rays += other.reflection_rays;
+    sphere_tests += other.sphere_tests;
+    triangle_tests += other.triangle_tests;
+    cone_tests += other.cone_tests;
+    cylinder_tests += other.cylinder_tests;
+    triangle_block_tests += other.triangle_block_tests;
+    mesh_triangle_tests += other.mesh_triangle_tests;
+    bvh_nodes += other.bvh_nodes;
+    texture_lookups += other.texture_lookups;
+    return *this;
+}
+
+bool RenderStats::writeJson(string const &filename) const {
+    json rays = {
+            {"primary",    counters.primary_rays},
+            {"shadow",     counters.shadow_rays},
+            {"reflection", counters.reflection_rays}
+    };
+    json tests = {
+            {"sphere",         counters.sphere_tests},
+            {"triangle",       counters.triangle_tests},
+            {"cone",           counters.cone_tests},
+            {"cylinder",       counters.cylinder_tests},
+            {"triangle_block", counters.triangle_block_tests},
+            {"mesh_triangle",  counters.mesh_triangle_tests}
+    };
+    json seconds = {
+            {"scene_parse",    times.scene_parse},
+            {"mesh_load",      times.mesh_load},
+            {"texture_decode", times.texture_decode},
+            {"accel_build",    times.accel_build},
+            {"render",         times.render},
+            {"png_encode",     times.png_encode}
+    };
+    uint64_t total_rays = counters.primary_rays + counters.shadow_rays + counters.reflection_rays;
+
+    json stats;
+    stats["width"] = width;
+    stats["height"] = height;
+    stats["threads"] = threads;
+    stats["rays"] = rays;
+    stats["samples_per_pixel"] = width * height > 0 ? double(counters.primary_rays) / (double(width) * height) : 0.0;
+    stats["intersection_tests"] = tests;
+    stats["bvh_nodes_visited"] = counters.bvh_nodes;
+    stats["texture_lookups"] = counters.texture_lookups;
+    stats["seconds"] = seconds;
+    stats["rays_per_second"] = times.render > 0 ? total_rays / times.render : 0.0;
+
+    ofstream out(filename);
+    out << setw(4) << stats << '\n';
+    return static_cast<bool>(out);
+}
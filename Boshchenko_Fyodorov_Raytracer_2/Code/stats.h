@@ -0,0 +1,90 @@
+#ifndef STATS_H_
+#define STATS_H_
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+/**
+ * Work done by one thread while rendering. Every thread counts into its own
+ * copy (threadCounters()), so the hot path never shares a cache line with
+ * another thread; Scene::render adds up the copies of its workers once they
+ * are done.
+ */
+struct RenderCounters {
+    uint64_t primary_rays = 0;
+    uint64_t shadow_rays = 0;
+    uint64_t reflection_rays = 0;
+    uint64_t sphere_tests = 0;          // ray-primitive intersection tests, packets count per ray
+    uint64_t triangle_tests = 0;
+    uint64_t cone_tests = 0;
+    uint64_t cylinder_tests = 0;
+    uint64_t triangle_block_tests = 0;  // SIMD tests of a ray against a whole mesh TriangleBlock
+    uint64_t mesh_triangle_tests = 0;   // exact tests of the candidates reported by the blocks
+    uint64_t bvh_nodes = 0;             // nodes visited in the scene and mesh hierarchies
+    uint64_t texture_lookups = 0;
+
+    RenderCounters &operator+=(RenderCounters const &other);
+};
+
+// The counters of the calling thread
+extern thread_local RenderCounters thread_counters;
+
+inline RenderCounters &threadCounters() {
+    return thread_counters;
+}
+
+// Wall-clock seconds spent per phase; the phases do not overlap
+struct PhaseTimes {
+    double scene_parse = 0;     // reading the json, without the phases below
+    double mesh_load = 0;
+    double texture_decode = 0;
+    double accel_build = 0;     // scene and mesh BVHs
+    double render = 0;
+    double png_encode = 0;
+};
+
+class Stopwatch {
+    std::chrono::steady_clock::time_point start;
+
+public:
+    Stopwatch()
+            :
+            start(std::chrono::steady_clock::now()) {}
+
+    double seconds() const {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+};
+
+// Adds the lifetime of the timer to 'total'
+class ScopedTimer {
+    Stopwatch watch;
+    double &total;
+
+public:
+    explicit ScopedTimer(double &total)
+            :
+            total(total) {}
+
+    ~ScopedTimer() {
+        total += watch.seconds();
+    }
+
+    ScopedTimer(ScopedTimer const &) = delete;
+
+    ScopedTimer &operator=(ScopedTimer const &) = delete;
+};
+
+struct RenderStats {
+    RenderCounters counters;
+    PhaseTimes times;
+    unsigned width = 0;         // size of the rendered region
+    unsigned height = 0;
+    unsigned threads = 0;       // workers used by the render
+
+    // Writes everything as a json object, returns false if the file cannot be written
+    bool writeJson(std::string const &filename) const;
+};
+
+#endif
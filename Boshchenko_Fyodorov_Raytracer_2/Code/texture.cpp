@@ -0,0 +1,152 @@
+#include "texture.h"
+#include "image.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace std;
+
+namespace {
+
+uint8_t toByte(float value) {
+    return static_cast<uint8_t>(lround(min(max(value, 0.0f), 1.0f) * 255));
+}
+
+}
+
+array<float, 256> const Texture::UNIT = [] {
+    array<float, 256> unit;
+    for (unsigned byte = 0; byte < unit.size(); ++byte) {
+        unit[byte] = static_cast<float>(byte / 255.0);
+    }
+    return unit;
+}();
+
+Texture::Texture(Image const &image, Layout layout)
+        :
+        texel_layout(LINEAR) {
+    unsigned width = image.width(), height = image.height();
+    if (width == 0 || height == 0) {
+        width = height = 1;
+    }
+    setLevels(width, height);
+    owned.resize(numTexels(width, height, LINEAR));
+
+    // Level 0 gets the bytes the PNG had, the image holds them as byte / 255
+    for (unsigned y = 0; y < image.height(); ++y) {
+        for (unsigned x = 0; x < image.width(); ++x) {
+            Pixel const &pixel = image(x, y);
+            owned[size_t(y) * width + x] = Texel{toByte(pixel.r), toByte(pixel.g), toByte(pixel.b), 255};
+        }
+    }
+    if (image.size() == 0) {
+        owned[0] = Texel{0, 0, 0, 255};
+    }
+
+    // Every further level averages 2x2 texels of the one before (the last row
+    // or column of an odd size is used twice)
+    for (size_t idx = 1; idx < levels.size(); ++idx) {
+        Level const &source = levels[idx - 1], &target = levels[idx];
+        for (unsigned y = 0; y < target.height; ++y) {
+            unsigned y0 = min(2 * y, source.height - 1), y1 = min(2 * y + 1, source.height - 1);
+            for (unsigned x = 0; x < target.width; ++x) {
+                unsigned x0 = min(2 * x, source.width - 1), x1 = min(2 * x + 1, source.width - 1);
+                Texel const &a = owned[at(source, x0, y0)], &b = owned[at(source, x1, y0)],
+                        &c = owned[at(source, x0, y1)], &d = owned[at(source, x1, y1)];
+                owned[at(target, x, y)] = Texel{
+                        static_cast<uint8_t>((a.r + b.r + c.r + d.r + 2) / 4),
+                        static_cast<uint8_t>((a.g + b.g + c.g + d.g + 2) / 4),
+                        static_cast<uint8_t>((a.b + b.b + c.b + d.b + 2) / 4),
+                        static_cast<uint8_t>((a.a + b.a + c.a + d.a + 2) / 4)};
+            }
+        }
+    }
+
+    if (layout == TILED) {
+        // Rearranged once all levels exist; the padding of partial tiles stays black
+        vector<Level> linear = levels;
+        vector<Texel> rows;
+        rows.swap(owned);
+        texel_layout = TILED;
+        setLevels(width, height);
+        owned.resize(numTexels(width, height, TILED), Texel{0, 0, 0, 255});
+        for (size_t idx = 0; idx < levels.size(); ++idx) {
+            Level const &source = linear[idx], &target = levels[idx];
+            for (unsigned y = 0; y < target.height; ++y) {
+                for (unsigned x = 0; x < target.width; ++x) {
+                    owned[at(target, x, y)] = rows[source.offset + size_t(y) * source.width + x];
+                }
+            }
+        }
+    }
+    texels = owned.data();
+}
+
+Texture::Texture(unsigned width, unsigned height, Layout layout, shared_ptr<Texel const> texels)
+        :
+        texel_layout(layout),
+        shared(move(texels)) {
+    setLevels(width, height);
+    this->texels = shared.get();
+}
+
+void Texture::setLevels(unsigned width, unsigned height) {
+    levels.clear();
+    size_t offset = 0;
+    float scale = 1;
+    for (;;) {
+        unsigned tiles = (width + TILE - 1) / TILE;
+        levels.push_back(Level{width, height, offset, scale, tiles});
+        scale /= 2;
+        offset += levelTexels(width, height, texel_layout);
+        if (width == 1 && height == 1) {
+            break;
+        }
+        width = max(1U, width / 2);
+        height = max(1U, height / 2);
+    }
+}
+
+size_t Texture::levelTexels(unsigned width, unsigned height, Layout layout) {
+    if (layout == TILED) {
+        // whole tiles
+        return size_t((width + TILE - 1) / TILE) * ((height + TILE - 1) / TILE) * TILE * TILE;
+    }
+    return size_t(width) * height;
+}
+
+size_t Texture::numTexels(unsigned width, unsigned height, Layout layout) {
+    size_t count = 0;
+    for (;;) {
+        count += levelTexels(width, height, layout);
+        if (width <= 1 && height <= 1) {
+            return count;
+        }
+        width = max(1U, width / 2);
+        height = max(1U, height / 2);
+    }
+}
+
+bool Texture::parseFilter(string const &name, Filter &filter) {
+    if (name == "nearest") {
+        filter = NEAREST;
+    } else if (name == "bilinear") {
+        filter = BILINEAR;
+    } else if (name == "trilinear") {
+        filter = TRILINEAR;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+bool Texture::parseLayout(string const &name, Layout &layout) {
+    if (name == "linear") {
+        layout = LINEAR;
+    } else if (name == "tiled") {
+        layout = TILED;
+    } else {
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,223 @@
+#ifndef TEXTURE_H_
+#define TEXTURE_H_
+
+#include "triple.h"
+
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+class Image;
+
+/**
+ * An image prepared for sampling: 8-bit RGBA texels (4 bytes each instead
+ * of the 16 of an Image pixel) and a mip chain down to 1x1, every level the
+ * 2x2 box filter of the one before. All levels lie in one array, level 0
+ * first. The lookups are inline and do not check their coordinates:
+ *   colorAt    the nearest texel of level 0, the one Image::colorAt picks
+ *   bilinear   the four nearest texels of a level, u repeats and v clamps
+ *   trilinear  bilinear on the two levels around a fractional level of detail
+ * Level 0 holds the PNG bytes exactly, so colorAt returns the colors of
+ * Image::colorAt.
+ *
+ * The texels of a level are stored row by row (LINEAR) or in tiles of 4x4
+ * texels (TILED), each tile one 64 byte cache line and the tiles row by row.
+ * A sphere maps longitude and latitude to u and v, so the pixels next to
+ * each other on screen read texels from different rows, which a tile keeps
+ * in one line. The layout does not change what the lookups return.
+ */
+class Texture {
+public:
+    enum Filter {
+        NEAREST, BILINEAR, TRILINEAR
+    };
+
+    enum Layout {
+        LINEAR, TILED
+    };
+
+    struct Texel {
+        uint8_t r, g, b, a;
+    };
+
+    // Converts and mipmaps an image, one that could not be read becomes 1x1 black
+    explicit Texture(Image const &image, Layout layout = LINEAR);
+
+    // Over numTexels(width, height, layout) texels owned elsewhere, e.g. a mapped file
+    Texture(unsigned width, unsigned height, Layout layout, std::shared_ptr<Texel const> texels);
+
+    Texture(Texture const &) = delete;
+
+    Texture &operator=(Texture const &) = delete;
+
+    unsigned width() const {
+        return levels[0].width;
+    }
+
+    unsigned height() const {
+        return levels[0].height;
+    }
+
+    unsigned numLevels() const {
+        return static_cast<unsigned>(levels.size());
+    }
+
+    Layout texelLayout() const {
+        return texel_layout;
+    }
+
+    // the texels of all levels
+    Texel const *data() const {
+        return texels;
+    }
+
+    // number of texels of all levels of a width x height texture, padding included
+    static size_t numTexels(unsigned width, unsigned height, Layout layout);
+
+    // Index in data() of the texel colorAt returns
+    size_t nearest(float u, float v) const {
+        // Scaled by size - 1 and truncated like Image::colorAt; a negative u
+        // (a sphere maps u to [-0.5, 0.5]) falls into the row before
+        Level const &level = levels[0];
+        int64_t x = static_cast<int64_t>(u * (level.width - 1)),
+                y = static_cast<int64_t>(v * (level.height - 1));
+        int64_t size = int64_t(level.width) * level.height,
+                index = y * level.width + x;
+        index = index < 0 ? index + size : (index >= size ? size - 1 : index);
+        if (texel_layout == LINEAR) {
+            return size_t(index);
+        }
+        // The same texel by its position; only a u outside [-1, 1] needs the division
+        if (x < 0) {
+            x += level.width;
+            --y;
+        }
+        if (x < 0 || x >= level.width || y < 0 || y >= level.height) {
+            x = index % level.width;
+            y = index / level.width;
+        }
+        return at(level, unsigned(x), unsigned(y));
+    }
+
+    Color colorAt(float u, float v) const {
+        return Color(color(texels[nearest(u, v)]));
+    }
+
+    Color bilinear(float u, float v, unsigned level) const {
+        float x, y;
+        coordinates(u, v, x, y);
+        return Color(bilinearAt(x, y, levels[level]));
+    }
+
+    Color trilinear(float u, float v, float lod) const {
+        float last = static_cast<float>(levels.size() - 1);
+        lod = std::fmin(std::fmax(lod, 0.0f), last);
+        unsigned level = static_cast<unsigned>(lod);
+        float fraction = lod - level, x, y;
+        coordinates(u, v, x, y);
+        if (fraction == 0) {
+            return Color(bilinearAt(x, y, levels[level]));
+        }
+        return Color(lerp(bilinearAt(x, y, levels[level]), bilinearAt(x, y, levels[level + 1]), fraction));
+    }
+
+    // lod is the level of detail, log2 of the texels a sample covers
+    Color sample(float u, float v, Filter filter, float lod) const {
+        switch (filter) {
+            case BILINEAR:
+                return bilinear(u, v, 0);
+            case TRILINEAR:
+                return trilinear(u, v, lod);
+            default:
+                return colorAt(u, v);
+        }
+    }
+
+    // Accepts "nearest", "bilinear" and "trilinear"
+    static bool parseFilter(std::string const &name, Filter &filter);
+
+    // Accepts "linear" and "tiled"
+    static bool parseLayout(std::string const &name, Layout &layout);
+
+private:
+    struct Level {
+        unsigned width;
+        unsigned height;
+        size_t offset;      // of its first texel
+        float scale;        // 2^-level, from level 0 to level texel coordinates
+        unsigned tiles;     // tiles per row in the TILED layout
+    };
+
+    // A tile is TILE x TILE texels
+    static unsigned const TILE_SHIFT = 2, TILE = 1U << TILE_SHIFT;
+
+    // byte / 255 rounded to float, as an Image stores a PNG
+    static std::array<float, 256> const UNIT;
+
+    Layout texel_layout;
+    std::vector<Level> levels;
+    std::vector<Texel> owned;
+    std::shared_ptr<Texel const> shared;
+    Texel const *texels = nullptr;
+
+    void setLevels(unsigned width, unsigned height);
+
+    static size_t levelTexels(unsigned width, unsigned height, Layout layout);
+
+    // index of texel (x, y) of a level
+    size_t at(Level const &level, unsigned x, unsigned y) const {
+        if (texel_layout == LINEAR) {
+            return level.offset + size_t(y) * level.width + x;
+        }
+        return level.offset + ((size_t(y >> TILE_SHIFT) * level.tiles + (x >> TILE_SHIFT)) << (2 * TILE_SHIFT)) +
+               ((y & (TILE - 1)) << TILE_SHIFT) + (x & (TILE - 1));
+    }
+
+    static Colorf color(Texel const &t) {
+        return Colorf(UNIT[t.r], UNIT[t.g], UNIT[t.b]);
+    }
+
+    // Texel coordinates in level 0 as colorAt computes them, texel k covers
+    // [k, k + 1); a negative u falls into the row before there as well
+    void coordinates(float u, float v, float &x, float &y) const {
+        Level const &base = levels[0];
+        x = u * (base.width - 1);
+        y = v * (base.height - 1);
+        if (x < 0) {
+            x += base.width;
+            y -= 1;
+        }
+    }
+
+    // Bilinear filter of a level at level 0 coordinates
+    Colorf bilinearAt(float x, float y, Level const &level) const {
+        x = x * level.scale - 0.5f;
+        y = std::fmin(std::fmax(y * level.scale - 0.5f, 0.0f), level.height - 1.0f);
+        int64_t x0 = static_cast<int64_t>(std::floor(x));
+        unsigned y0 = static_cast<unsigned>(y), y1 = y0 + 1 < level.height ? y0 + 1 : y0;
+        float fx = x - x0, fy = y - y0;
+        unsigned left = wrap(x0, level.width), right = wrap(x0 + 1, level.width);
+        Colorf top = lerp(color(texels[at(level, left, y0)]), color(texels[at(level, right, y0)]), fx),
+                bottom = lerp(color(texels[at(level, left, y1)]), color(texels[at(level, right, y1)]), fx);
+        return lerp(top, bottom, fy);
+    }
+
+    // u repeats
+    static unsigned wrap(int64_t x, unsigned width) {
+        if (x >= 0 && x < width) {
+            return static_cast<unsigned>(x);
+        }
+        int64_t rest = x % int64_t(width);
+        return static_cast<unsigned>(rest < 0 ? rest + width : rest);
+    }
+
+    static Colorf lerp(Colorf const &a, Colorf const &b, float f) {
+        return a + f * (b - a);
+    }
+};
+
+#endif
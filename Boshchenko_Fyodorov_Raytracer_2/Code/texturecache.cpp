@@ -0,0 +1,152 @@
+#include "texturecache.h"
+#include "image.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <cstdio>
+#include <cstring>
+
+using namespace std;
+
+namespace {
+
+char const MAGIC[8] = {'R', 'A', 'Y', 'T', 'E', 'X', 'L', '\n'};
+uint32_t const VERSION = 3;     // 1 held float texels without mip levels, 2 had no layout
+
+// 64 bytes, so that the texels behind it are well aligned
+struct SidecarHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t texel_size;    // sizeof(Texture::Texel), the texels of all levels are stored as in memory
+    uint32_t width;
+    uint32_t height;
+    int64_t png_mtime;      // FileStamp of the PNG the texels were decoded from
+    int64_t png_size;
+    uint32_t layout;        // Texture::Layout of the texels
+    char padding[20];
+};
+
+static_assert(sizeof(SidecarHeader) == 64, "the texels must start 64 bytes into a sidecar");
+
+// The texels of a sidecar that belongs to a PNG with stamp and holds them in
+// layout, nullptr if there is none
+TexturePtr mapSidecar(string const &sidecar, FileStamp const &stamp, Texture::Layout layout) {
+    int fd = open(sidecar.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return nullptr;
+    }
+    struct stat info;
+    void *base = MAP_FAILED;
+    size_t length = 0;
+    if (fstat(fd, &info) == 0 && size_t(info.st_size) >= sizeof(SidecarHeader)) {
+        length = size_t(info.st_size);
+        base = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+    }
+    close(fd);  // the mapping stays valid
+    if (base == MAP_FAILED) {
+        return nullptr;
+    }
+
+    SidecarHeader const &header = *static_cast<SidecarHeader const *>(base);
+    if (memcmp(header.magic, MAGIC, sizeof MAGIC) != 0 || header.version != VERSION ||
+        header.texel_size != sizeof(Texture::Texel) || header.png_mtime != stamp.mtime ||
+        header.png_size != stamp.size || header.layout != uint32_t(layout) || header.width == 0 ||
+        header.height == 0 ||
+        length != sizeof header + sizeof(Texture::Texel) * Texture::numTexels(header.width, header.height, layout)) {
+        munmap(base, length);
+        return nullptr;
+    }
+    shared_ptr<Texture::Texel const> texels(
+            reinterpret_cast<Texture::Texel const *>(static_cast<char const *>(base) + sizeof header),
+            [base, length](Texture::Texel const *) {
+                munmap(base, length);
+            });
+    return make_shared<Texture const>(header.width, header.height, layout, texels);
+}
+
+// Best effort: a directory that cannot be written just means no sidecar
+void writeSidecar(string const &sidecar, Texture const &texture, FileStamp const &stamp) {
+    SidecarHeader header;
+    memset(&header, 0, sizeof header);
+    memcpy(header.magic, MAGIC, sizeof MAGIC);
+    header.version = VERSION;
+    header.texel_size = sizeof(Texture::Texel);
+    header.width = texture.width();
+    header.height = texture.height();
+    header.png_mtime = stamp.mtime;
+    header.png_size = stamp.size;
+    header.layout = texture.texelLayout();
+
+    string temporary = sidecar + ".tmp" + to_string(getpid());
+    FILE *out = fopen(temporary.c_str(), "wb");
+    if (!out) {
+        return;
+    }
+    size_t count = Texture::numTexels(texture.width(), texture.height(), texture.texelLayout());
+    bool ok = fwrite(&header, sizeof header, 1, out) == 1 &&
+              fwrite(texture.data(), sizeof(Texture::Texel), count, out) == count;
+    ok = fclose(out) == 0 && ok;
+    if (!ok || rename(temporary.c_str(), sidecar.c_str()) != 0) {
+        remove(temporary.c_str());
+    }
+}
+
+}
+
+TextureCache &TextureCache::instance() {
+    static TextureCache cache;
+    return cache;
+}
+
+void TextureCache::setSidecars(bool enabled) {
+    lock_guard<std::mutex> lock(mutex);
+    sidecars = enabled;
+}
+
+void TextureCache::setLayout(Texture::Layout texel_layout) {
+    lock_guard<std::mutex> lock(mutex);
+    layout = texel_layout;
+}
+
+TexturePtr TextureCache::get(string const &filename, bool *loaded) {
+    FileStamp stamp;
+    bool exists = FileStamp::read(filename, stamp);
+    lock_guard<std::mutex> lock(mutex);
+    auto found = entries.find(filename);
+    if (exists && found != entries.end() && found->second.stamp == stamp &&
+        found->second.texture->texelLayout() == layout) {
+        if (loaded) {
+            *loaded = false;
+        }
+        return found->second.texture;
+    }
+    if (loaded) {
+        *loaded = true;
+    }
+    if (!exists) {
+        // Decoding reports the missing file, and no stale copy is kept
+        entries.erase(filename);
+        return make_shared<Texture const>(Image(filename), layout);
+    }
+    Entry &entry = entries[filename];
+    entry.texture = load(filename, stamp);
+    entry.stamp = stamp;
+    return entry.texture;
+}
+
+TexturePtr TextureCache::load(string const &filename, FileStamp const &stamp) const {
+    string sidecar = filename + ".texels";
+    if (sidecars) {
+        if (TexturePtr mapped = mapSidecar(sidecar, stamp, layout)) {
+            return mapped;
+        }
+    }
+    Image image(filename);
+    TexturePtr texture = make_shared<Texture const>(image, layout);
+    if (sidecars && image.size() > 0) {
+        writeSidecar(sidecar, *texture, stamp);
+    }
+    return texture;
+}
@@ -0,0 +1,56 @@
+#ifndef TEXTURECACHE_H_
+#define TEXTURECACHE_H_
+
+#include "filestamp.h"
+#include "texture.h"
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+// Textures are immutable once loaded, so copies of a Material share them
+typedef std::shared_ptr<Texture const> TexturePtr;
+
+/**
+ * The decoded textures of the whole process, keyed by file path: materials
+ * that name the same PNG share one Texture, and a file is only decoded again
+ * once its modification time or size changed. With sidecars on, the texels
+ * of a decoded PNG and its mip levels are also written to <png>.texels, and
+ * later runs map that file read-only instead of inflating and filtering the
+ * PNG (the sidecar records the mtime and size of its PNG and is ignored once
+ * they differ). Sidecars are written to a temporary name and renamed, so a
+ * process never maps half a file. All textures have the texel layout of
+ * setLayout(); one cached in another layout is loaded again. Thread safe.
+ */
+class TextureCache {
+public:
+    static TextureCache &instance();
+
+    // The texture in a PNG file; loaded (if given) tells whether the file
+    // had to be read instead of being found in the cache
+    TexturePtr get(std::string const &filename, bool *loaded = nullptr);
+
+    // Read and write <png>.texels sidecars, off by default
+    void setSidecars(bool enabled);
+
+    // Texture::LINEAR by default
+    void setLayout(Texture::Layout texel_layout);
+
+private:
+    struct Entry {
+        FileStamp stamp;
+        TexturePtr texture;
+    };
+
+    std::mutex mutex;
+    std::map<std::string, Entry> entries;
+    bool sidecars = false;
+    Texture::Layout layout = Texture::LINEAR;
+
+    TextureCache() = default;
+
+    TexturePtr load(std::string const &filename, FileStamp const &stamp) const;
+};
+
+#endif
@@ -0,0 +1,40 @@
+#include "tilequeue.h"
+
+using namespace std;
+
+TileQueue::TileQueue(vector<Tile> const &tiles, unsigned workers) {
+    for (unsigned worker = 0; worker < workers; ++worker) {
+        queues.emplace_back(new WorkerQueue());
+        // Hand out contiguous runs so that a worker stays in one image region
+        size_t begin = tiles.size() * worker / workers,
+                end = tiles.size() * (worker + 1) / workers;
+        queues.back()->tiles.assign(tiles.begin() + begin, tiles.begin() + end);
+    }
+}
+
+bool TileQueue::pop(unsigned worker, Tile &tile) {
+    {
+        WorkerQueue &own = *queues[worker];
+        lock_guard<mutex> lock(own.mutex);
+        if (!own.tiles.empty()) {
+            tile = own.tiles.front();
+            own.tiles.pop_front();
+            return true;
+        }
+    }
+    return steal(worker, tile);
+}
+
+bool TileQueue::steal(unsigned worker, Tile &tile) {
+    // No tiles are ever added, so one sweep over the other queues suffices
+    for (size_t offset = 1; offset < queues.size(); ++offset) {
+        WorkerQueue &victim = *queues[(worker + offset) % queues.size()];
+        lock_guard<mutex> lock(victim.mutex);
+        if (!victim.tiles.empty()) {
+            tile = victim.tiles.back();
+            victim.tiles.pop_back();
+            return true;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,40 @@
+#ifndef TILEQUEUE_H_
+#define TILEQUEUE_H_
+
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// Rectangle of pixels [x0, x1) x [y0, y1)
+struct Tile {
+    unsigned x0, y0;
+    unsigned x1, y1;
+};
+
+/**
+ * Work-stealing tile queue. Every worker owns a deque that initially holds a
+ * contiguous run of tiles; it takes work from the front of its own deque and,
+ * once that is empty, steals from the back of another worker's deque. Cheap
+ * regions therefore never leave a thread idle while another one is stuck on
+ * reflective or supersampled tiles.
+ */
+class TileQueue {
+public:
+    TileQueue(std::vector<Tile> const &tiles, unsigned workers);
+
+    // Fetches the next tile for 'worker', returns false when all work is done
+    bool pop(unsigned worker, Tile &tile);
+
+private:
+    struct WorkerQueue {
+        std::mutex mutex;
+        std::deque<Tile> tiles;
+    };
+
+    std::vector<std::unique_ptr<WorkerQueue>> queues;
+
+    bool steal(unsigned worker, Tile &tile);
+};
+
+#endif
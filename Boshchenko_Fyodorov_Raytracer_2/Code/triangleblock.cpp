@@ -0,0 +1,266 @@
+#include "triangleblock.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define RAY_X86_SIMD 1
+#include <immintrin.h>
+#endif
+
+// Slack on the barycentric coordinates on top of the rounding error below
+static float constexpr BARY_TOLERANCE = 1e-3f;
+
+// u, v, t and the determinant are triple products of the edges, the ray
+// direction d and tvec = o - a. The float test rounds its inputs and every
+// step, so each is off by at most about 16 units in the last place of the
+// product of the magnitudes of its factors. With
+//     h = ERROR * |d| * span / |det|
+// the errors of u and v stay below h * (|tvec| + span) and the error of t
+// below h * span * (|tvec| + |t|); the relative error of the determinant is
+// below h * span. |tvec| is bounded by ray.reach + block.reach, which also
+// covers the rounding of the origin and the corners into the local frame.
+static float constexpr ERROR = 16 * 6e-8f;
+
+// A lane whose rounding error may exceed this (a tiny, zero or NaN
+// determinant: a grazing ray, a sliver or a far away triangle) is undecided
+// and always a candidate for the double test
+static float constexpr MAX_ERROR = 0.25f;
+
+TriangleBlock::TriangleBlock()
+        :
+        ax(), ay(), az(),
+        e1x(), e1y(), e1z(),
+        e2x(), e2y(), e2z(),
+        span(), reach(),
+        count(0),
+        triangle() {}
+
+void TriangleBlock::add(Point const &a, Point const &b, Point const &c, unsigned index) {
+    if (count == 0) {
+        anchor = a;
+    }
+    Vector local = a - anchor, e1 = b - a, e2 = c - a;
+    ax[count] = static_cast<float>(local.x);
+    ay[count] = static_cast<float>(local.y);
+    az[count] = static_cast<float>(local.z);
+    e1x[count] = static_cast<float>(e1.x);
+    e1y[count] = static_cast<float>(e1.y);
+    e1z[count] = static_cast<float>(e1.z);
+    e2x[count] = static_cast<float>(e2.x);
+    e2y[count] = static_cast<float>(e2.y);
+    e2z[count] = static_cast<float>(e2.z);
+    span[count] = static_cast<float>(std::fabs(e1.x) + std::fabs(e1.y) + std::fabs(e1.z) +
+                                     std::fabs(e2.x) + std::fabs(e2.y) + std::fabs(e2.z));
+    reach[count] = static_cast<float>(std::fabs(local.x) + std::fabs(local.y) + std::fabs(local.z)) + span[count];
+    triangle[count] = index;
+    ++count;
+}
+
+BlockRay::BlockRay(TriangleBlock const &block, Ray const &ray, double t_max) {
+    Vector local = ray.O - block.anchor;
+    ox = static_cast<float>(local.x);
+    oy = static_cast<float>(local.y);
+    oz = static_cast<float>(local.z);
+    dx = static_cast<float>(ray.D.x);
+    dy = static_cast<float>(ray.D.y);
+    dz = static_cast<float>(ray.D.z);
+    error = ERROR * std::max(1.0f, std::fabs(dx) + std::fabs(dy) + std::fabs(dz));
+    reach = static_cast<float>(std::fabs(local.x) + std::fabs(local.y) + std::fabs(local.z));
+    // Widen the interval by the rounding error a float distance may have this far from the anchor
+    double slack = 1e-3 * (1.0 + local.length());
+    t_min = static_cast<float>(-slack);
+    this->t_max = std::isinf(t_max) ? std::numeric_limits<float>::infinity()
+                                    : static_cast<float>(t_max * (1.0 + 1e-3) + slack);
+}
+
+unsigned intersectBlockScalar(TriangleBlock const &block, BlockRay const &ray) {
+    unsigned mask = 0;
+    for (unsigned lane = 0; lane < block.count; ++lane) {
+        float px = ray.dy * block.e2z[lane] - ray.dz * block.e2y[lane],
+                py = ray.dz * block.e2x[lane] - ray.dx * block.e2z[lane],
+                pz = ray.dx * block.e2y[lane] - ray.dy * block.e2x[lane];
+        float inv_det = 1.0f / (block.e1x[lane] * px + block.e1y[lane] * py + block.e1z[lane] * pz);
+
+        float tx = ray.ox - block.ax[lane],
+                ty = ray.oy - block.ay[lane],
+                tz = ray.oz - block.az[lane];
+        float u = (tx * px + ty * py + tz * pz) * inv_det;
+
+        float qx = ty * block.e1z[lane] - tz * block.e1y[lane],
+                qy = tz * block.e1x[lane] - tx * block.e1z[lane],
+                qz = tx * block.e1y[lane] - ty * block.e1x[lane];
+        float v = (ray.dx * qx + ray.dy * qy + ray.dz * qz) * inv_det;
+        float t = (block.e2x[lane] * qx + block.e2y[lane] * qy + block.e2z[lane] * qz) * inv_det;
+
+        // Rounding error of this lane, see ERROR
+        float h = ray.error * block.span[lane] * std::fabs(inv_det);
+        float error = h * (ray.reach + block.reach[lane]);
+        float t_error = h * block.span[lane] * (ray.reach + block.reach[lane] + std::fabs(t));
+        bool undecided = !(error <= MAX_ERROR);
+        float lower = -BARY_TOLERANCE - error, upper = 1.0f + BARY_TOLERANCE + 2.0f * error;
+
+        if (undecided || (u >= lower && v >= lower && u + v <= upper &&
+                          t > ray.t_min - t_error && t < ray.t_max + t_error)) {
+            mask |= 1U << lane;
+        }
+    }
+    return mask;
+}
+
+#ifdef RAY_X86_SIMD
+
+// SSE2 is part of x86-64, so this kernel needs no runtime check
+unsigned intersectBlockSSE(TriangleBlock const &block, BlockRay const &ray) {
+    __m128 const dx = _mm_set1_ps(ray.dx), dy = _mm_set1_ps(ray.dy), dz = _mm_set1_ps(ray.dz);
+    __m128 const ox = _mm_set1_ps(ray.ox), oy = _mm_set1_ps(ray.oy), oz = _mm_set1_ps(ray.oz);
+    __m128 const tolerance = _mm_set1_ps(BARY_TOLERANCE), one = _mm_set1_ps(1.0f);
+    __m128 const t_min = _mm_set1_ps(ray.t_min), t_max = _mm_set1_ps(ray.t_max);
+    __m128 const error_scale = _mm_set1_ps(ray.error), ray_reach = _mm_set1_ps(ray.reach);
+    __m128 const max_error = _mm_set1_ps(MAX_ERROR), sign = _mm_set1_ps(-0.0f);
+
+    unsigned mask = 0;
+    for (int base = 0; base < TriangleBlock::WIDTH; base += 4) {
+        __m128 e1x = _mm_loadu_ps(block.e1x + base), e1y = _mm_loadu_ps(block.e1y + base),
+                e1z = _mm_loadu_ps(block.e1z + base);
+        __m128 e2x = _mm_loadu_ps(block.e2x + base), e2y = _mm_loadu_ps(block.e2y + base),
+                e2z = _mm_loadu_ps(block.e2z + base);
+
+        __m128 px = _mm_sub_ps(_mm_mul_ps(dy, e2z), _mm_mul_ps(dz, e2y)),
+                py = _mm_sub_ps(_mm_mul_ps(dz, e2x), _mm_mul_ps(dx, e2z)),
+                pz = _mm_sub_ps(_mm_mul_ps(dx, e2y), _mm_mul_ps(dy, e2x));
+        __m128 det = _mm_add_ps(_mm_add_ps(_mm_mul_ps(e1x, px), _mm_mul_ps(e1y, py)), _mm_mul_ps(e1z, pz));
+        __m128 inv_det = _mm_div_ps(_mm_set1_ps(1.0f), det);
+
+        __m128 tx = _mm_sub_ps(ox, _mm_loadu_ps(block.ax + base)),
+                ty = _mm_sub_ps(oy, _mm_loadu_ps(block.ay + base)),
+                tz = _mm_sub_ps(oz, _mm_loadu_ps(block.az + base));
+        __m128 u = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(tx, px), _mm_mul_ps(ty, py)),
+                                         _mm_mul_ps(tz, pz)), inv_det);
+
+        __m128 qx = _mm_sub_ps(_mm_mul_ps(ty, e1z), _mm_mul_ps(tz, e1y)),
+                qy = _mm_sub_ps(_mm_mul_ps(tz, e1x), _mm_mul_ps(tx, e1z)),
+                qz = _mm_sub_ps(_mm_mul_ps(tx, e1y), _mm_mul_ps(ty, e1x));
+        __m128 v = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, qx), _mm_mul_ps(dy, qy)),
+                                         _mm_mul_ps(dz, qz)), inv_det);
+        __m128 t = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(e2x, qx), _mm_mul_ps(e2y, qy)),
+                                         _mm_mul_ps(e2z, qz)), inv_det);
+
+        // Rounding error of every lane, see ERROR
+        __m128 span = _mm_loadu_ps(block.span + base);
+        __m128 reach = _mm_add_ps(ray_reach, _mm_loadu_ps(block.reach + base));
+        __m128 h = _mm_mul_ps(_mm_mul_ps(error_scale, span), _mm_andnot_ps(sign, inv_det));
+        __m128 error = _mm_mul_ps(h, reach);
+        __m128 t_error = _mm_mul_ps(_mm_mul_ps(h, span), _mm_add_ps(reach, _mm_andnot_ps(sign, t)));
+        __m128 lower = _mm_sub_ps(_mm_sub_ps(_mm_setzero_ps(), tolerance), error);
+        __m128 upper = _mm_add_ps(_mm_add_ps(one, tolerance), _mm_add_ps(error, error));
+
+        // Ordered compares: lanes with a NaN drop out of the test, the
+        // unordered one makes them (and lanes with a large error) undecided
+        __m128 hit = _mm_and_ps(_mm_cmpge_ps(u, lower), _mm_cmpge_ps(v, lower));
+        hit = _mm_and_ps(hit, _mm_cmple_ps(_mm_add_ps(u, v), upper));
+        hit = _mm_and_ps(hit, _mm_cmpgt_ps(t, _mm_sub_ps(t_min, t_error)));
+        hit = _mm_and_ps(hit, _mm_cmplt_ps(t, _mm_add_ps(t_max, t_error)));
+        hit = _mm_or_ps(hit, _mm_cmpnle_ps(error, max_error));
+        mask |= static_cast<unsigned>(_mm_movemask_ps(hit)) << base;
+    }
+    return mask & ((1U << block.count) - 1U);
+}
+
+__attribute__((target("avx2")))
+unsigned intersectBlockAVX2(TriangleBlock const &block, BlockRay const &ray) {
+    __m256 const dx = _mm256_set1_ps(ray.dx), dy = _mm256_set1_ps(ray.dy), dz = _mm256_set1_ps(ray.dz);
+
+    __m256 e1x = _mm256_loadu_ps(block.e1x), e1y = _mm256_loadu_ps(block.e1y), e1z = _mm256_loadu_ps(block.e1z);
+    __m256 e2x = _mm256_loadu_ps(block.e2x), e2y = _mm256_loadu_ps(block.e2y), e2z = _mm256_loadu_ps(block.e2z);
+
+    __m256 px = _mm256_sub_ps(_mm256_mul_ps(dy, e2z), _mm256_mul_ps(dz, e2y)),
+            py = _mm256_sub_ps(_mm256_mul_ps(dz, e2x), _mm256_mul_ps(dx, e2z)),
+            pz = _mm256_sub_ps(_mm256_mul_ps(dx, e2y), _mm256_mul_ps(dy, e2x));
+    __m256 det = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(e1x, px), _mm256_mul_ps(e1y, py)),
+                               _mm256_mul_ps(e1z, pz));
+    __m256 inv_det = _mm256_div_ps(_mm256_set1_ps(1.0f), det);
+
+    __m256 tx = _mm256_sub_ps(_mm256_set1_ps(ray.ox), _mm256_loadu_ps(block.ax)),
+            ty = _mm256_sub_ps(_mm256_set1_ps(ray.oy), _mm256_loadu_ps(block.ay)),
+            tz = _mm256_sub_ps(_mm256_set1_ps(ray.oz), _mm256_loadu_ps(block.az));
+    __m256 u = _mm256_mul_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(tx, px), _mm256_mul_ps(ty, py)),
+                                           _mm256_mul_ps(tz, pz)), inv_det);
+
+    __m256 qx = _mm256_sub_ps(_mm256_mul_ps(ty, e1z), _mm256_mul_ps(tz, e1y)),
+            qy = _mm256_sub_ps(_mm256_mul_ps(tz, e1x), _mm256_mul_ps(tx, e1z)),
+            qz = _mm256_sub_ps(_mm256_mul_ps(tx, e1y), _mm256_mul_ps(ty, e1x));
+    __m256 v = _mm256_mul_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(dx, qx), _mm256_mul_ps(dy, qy)),
+                                           _mm256_mul_ps(dz, qz)), inv_det);
+    __m256 t = _mm256_mul_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(e2x, qx), _mm256_mul_ps(e2y, qy)),
+                                           _mm256_mul_ps(e2z, qz)), inv_det);
+
+    // Rounding error of every lane, see ERROR
+    __m256 const sign = _mm256_set1_ps(-0.0f), tolerance = _mm256_set1_ps(BARY_TOLERANCE);
+    __m256 span = _mm256_loadu_ps(block.span);
+    __m256 reach = _mm256_add_ps(_mm256_set1_ps(ray.reach), _mm256_loadu_ps(block.reach));
+    __m256 h = _mm256_mul_ps(_mm256_mul_ps(_mm256_set1_ps(ray.error), span), _mm256_andnot_ps(sign, inv_det));
+    __m256 error = _mm256_mul_ps(h, reach);
+    __m256 t_error = _mm256_mul_ps(_mm256_mul_ps(h, span), _mm256_add_ps(reach, _mm256_andnot_ps(sign, t)));
+    __m256 lower = _mm256_sub_ps(_mm256_sub_ps(_mm256_setzero_ps(), tolerance), error);
+    __m256 upper = _mm256_add_ps(_mm256_add_ps(_mm256_set1_ps(1.0f), tolerance), _mm256_add_ps(error, error));
+
+    // Ordered, non-signalling compares: lanes with a NaN drop out of the test,
+    // the unordered one makes them (and lanes with a large error) undecided
+    __m256 hit = _mm256_and_ps(_mm256_cmp_ps(u, lower, _CMP_GE_OQ), _mm256_cmp_ps(v, lower, _CMP_GE_OQ));
+    hit = _mm256_and_ps(hit, _mm256_cmp_ps(_mm256_add_ps(u, v), upper, _CMP_LE_OQ));
+    hit = _mm256_and_ps(hit, _mm256_cmp_ps(t, _mm256_sub_ps(_mm256_set1_ps(ray.t_min), t_error), _CMP_GT_OQ));
+    hit = _mm256_and_ps(hit, _mm256_cmp_ps(t, _mm256_add_ps(_mm256_set1_ps(ray.t_max), t_error), _CMP_LT_OQ));
+    hit = _mm256_or_ps(hit, _mm256_cmp_ps(error, _mm256_set1_ps(MAX_ERROR), _CMP_NLE_UQ));
+    return static_cast<unsigned>(_mm256_movemask_ps(hit)) & ((1U << block.count) - 1U);
+}
+
+static TriangleBlockKernel selectKernel() {
+    bool has_avx2 = __builtin_cpu_supports("avx2");
+    char const *forced = getenv("RAY_SIMD");
+    if (forced && strcmp(forced, "scalar") == 0) {
+        return intersectBlockScalar;
+    }
+    if (forced && strcmp(forced, "sse") == 0) {
+        return intersectBlockSSE;
+    }
+    return has_avx2 ? intersectBlockAVX2 : intersectBlockSSE;
+}
+
+TriangleBlockKernel triangleBlockKernel() {
+    static TriangleBlockKernel const kernel = selectKernel();
+    return kernel;
+}
+
+char const *triangleBlockKernelName() {
+    TriangleBlockKernel kernel = triangleBlockKernel();
+    if (kernel == intersectBlockAVX2) {
+        return "avx2";
+    }
+    return kernel == intersectBlockSSE ? "sse" : "scalar";
+}
+
+#else
+
+// No vector units we know of: every kernel is the scalar one
+
+unsigned intersectBlockSSE(TriangleBlock const &block, BlockRay const &ray) {
+    return intersectBlockScalar(block, ray);
+}
+
+unsigned intersectBlockAVX2(TriangleBlock const &block, BlockRay const &ray) {
+    return intersectBlockScalar(block, ray);
+}
+
+TriangleBlockKernel triangleBlockKernel() {
+    return intersectBlockScalar;
+}
+
+char const *triangleBlockKernelName() {
+    return "scalar";
+}
+
+#endif
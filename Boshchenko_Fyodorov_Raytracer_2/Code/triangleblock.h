@@ -0,0 +1,65 @@
+#ifndef TRIANGLEBLOCK_H_
+#define TRIANGLEBLOCK_H_
+
+#include "ray.h"
+#include "triple.h"
+
+/**
+ * Up to WIDTH triangles in structure-of-arrays layout, one float lane per
+ * triangle: the first corner and the two precomputed edges. The corners are
+ * stored relative to 'anchor' so that the lanes keep their precision far away
+ * from the origin of the world. The kernels use unaligned loads, so blocks
+ * can live in a plain std::vector.
+ */
+struct TriangleBlock {
+    static int constexpr WIDTH = 8;
+
+    float ax[WIDTH], ay[WIDTH], az[WIDTH];      // a - anchor
+    float e1x[WIDTH], e1y[WIDTH], e1z[WIDTH];   // b - a
+    float e2x[WIDTH], e2y[WIDTH], e2z[WIDTH];   // c - a
+    float span[WIDTH];              // |e1| + |e2|, sums of absolute components
+    float reach[WIDTH];             // |a - anchor| + span, the same way
+    Point anchor;
+    unsigned count;                 // number of used lanes
+    unsigned triangle[WIDTH];       // owner's index of the triangle in every lane
+
+    TriangleBlock();
+
+    // Stores a triangle in the next free lane
+    void add(Point const &a, Point const &b, Point const &c, unsigned index);
+};
+
+// A ray moved into the local frame of one block
+struct BlockRay {
+    float ox, oy, oz;
+    float dx, dy, dz;
+    float t_min, t_max;
+    float error;                    // relative rounding error of the float test, see triangleblock.cpp
+    float reach;                    // |o - anchor|, sum of absolute components
+
+    BlockRay(TriangleBlock const &block, Ray const &ray, double t_max);
+};
+
+/**
+ * Single precision Möller–Trumbore test of one ray against all lanes of a
+ * block. The test is conservative: it returns a bit mask of the lanes that
+ * may be hit within t_max, and callers confirm those candidates with the
+ * exact double precision Triangle::distance. Every lane gets slack for the
+ * rounding error of its own float test, and a lane whose determinant is too
+ * small for the float test to decide is always a candidate.
+ */
+typedef unsigned (*TriangleBlockKernel)(TriangleBlock const &block, BlockRay const &ray);
+
+unsigned intersectBlockScalar(TriangleBlock const &block, BlockRay const &ray);
+
+unsigned intersectBlockSSE(TriangleBlock const &block, BlockRay const &ray);
+
+unsigned intersectBlockAVX2(TriangleBlock const &block, BlockRay const &ray);
+
+// The fastest kernel the CPU supports, chosen once at runtime. The
+// environment variable RAY_SIMD=scalar|sse|avx2 forces a (supported) kernel.
+TriangleBlockKernel triangleBlockKernel();
+
+char const *triangleBlockKernelName();
+
+#endif
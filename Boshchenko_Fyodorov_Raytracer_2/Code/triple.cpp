@@ -2,18 +2,20 @@
 
 #include "json/json.h"
 
+#include <iostream>
+
 using namespace std;
 using json = nlohmann::json;
 
+// The arithmetic is inline in triple.h; only the json and stream
+// conversions live here.
+
 // --- Constructors ------------------------------------------------------------
 
-Triple::Triple(double X, double Y, double Z)
-        :
-        x(X),
-        y(Y),
-        z(Z) {}
+namespace {
 
-Triple::Triple(json const &node) {
+template<typename T>
+void setFromJson(TripleT<T> &t, json const &node) {
     if (!node.is_array())
         throw runtime_error("Triple(): JSON node is not an array");
 
@@ -23,179 +25,61 @@ Triple::Triple(json const &node) {
     if (!node[0].is_number())
         throw runtime_error("Triple(): JSON node is not a number");
 
-    set(node[0], node[1], node[2]);
-}
-
-// --- Operators ---------------------------------------------------------------
-
-Triple Triple::operator+(Triple const &t) const {
-    return Triple(x + t.x, y + t.y, z + t.z);
-}
-
-Triple Triple::operator+(double f) const {
-    return Triple(x + f, y + f, z + f);
-}
-
-Triple Triple::operator-() const {
-    return Triple(-x, -y, -z);
-}
-
-Triple Triple::operator-(Triple const &t) const {
-    return Triple(x - t.x, y - t.y, z - t.z);
-}
-
-Triple Triple::operator-(double f) const {
-    return Triple(x - f, y - f, z - f);
-}
-
-Triple Triple::operator*(Triple const &t) const {
-    return Triple(x * t.x, y * t.y, z * t.z);
-}
-
-Triple Triple::operator*(double f) const {
-    return Triple(x * f, y * f, z * f);
-}
-
-Triple Triple::operator/(double f) const {
-    double invf = 1.0 / f;
-    return Triple(x * invf, y * invf, z * invf);
-}
-
-// --- Compound operators ------------------------------------------------------
-
-Triple &Triple::operator+=(Triple const &t) {
-    x += t.x;
-    y += t.y;
-    z += t.z;
-    return *this;
-}
-
-Triple &Triple::operator+=(double f) {
-    x += f;
-    y += f;
-    z += f;
-    return *this;
-}
-
-Triple &Triple::operator-=(Triple const &t) {
-    x -= t.x;
-    y -= t.y;
-    z -= t.z;
-    return *this;
-}
-
-Triple &Triple::operator-=(double f) {
-    x -= f;
-    y -= f;
-    z -= f;
-    return *this;
-}
-
-Triple &Triple::operator*=(double f) {
-    x *= f;
-    y *= f;
-    z *= f;
-    return *this;
-}
-
-Triple &Triple::operator/=(double f) {
-    double invf = 1.0 / f;
-    x *= invf;
-    y *= invf;
-    z *= invf;
-    return *this;
-}
-
-// --- Vector Operators --------------------------------------------------------
-
-double Triple::dot(Triple const &t) const {
-    return x * t.x + y * t.y + z * t.z;
-}
-
-Triple Triple::cross(Triple const &t) const {
-    return Triple(y * t.z - z * t.y,
-                  z * t.x - x * t.z,
-                  x * t.y - y * t.x);
+    t.set(node[0], node[1], node[2]);
 }
 
-double Triple::length() const {
-    return sqrt(length_2());
-}
-
-double Triple::length_2() const {
-    return x * x + y * y + z * z;
-}
-
-Triple Triple::normalized() const {
-    return (*this) / length();
-}
-
-void Triple::normalize() {
-    double len = length();
-    double invlen = 1.0 / len;
-    x *= invlen;
-    y *= invlen;
-    z *= invlen;
+template<typename T>
+istream &readTriple(istream &is, TripleT<T> &t) {
+    T x, y, z;
+    //  is >> x >> y >> z;      // is not guaranteed to work pre C++17
+    is >> x;
+    is >> y;
+    is >> z;
+    t.set(x, y, z);             // only assign if everything is extracted
+    return is;
 }
 
-// --- Color functions ---------------------------------------------------------
-
-void Triple::set(double f) {
-    r = f;
-    g = f;
-    b = f;
+template<typename T>
+ostream &writeTriple(ostream &os, TripleT<T> const &t) {
+    // format: [x, y, z] (no newline)
+    os << '[' << t.x << ", " << t.y << ", " << t.z << ']';
+    return os;
 }
 
-void Triple::set(double f, double maxValue) {
-    set(f / maxValue);
 }
 
-void Triple::set(double red, double green, double blue) {
-    r = red;
-    g = green;
-    b = blue;
+template<>
+TripleT<double>::TripleT(json const &node) {
+    setFromJson(*this, node);
 }
 
-void Triple::set(double red, double green, double blue, double maxValue) {
-    set(red / maxValue, green / maxValue, blue / maxValue);
+#ifdef RAY_SSE_TRIPLE
+TripleT<float>::TripleT(json const &node)
+        :
+        v(_mm_setzero_ps()) {
+    setFromJson(*this, node);
 }
-
-void Triple::clamp(double maxValue) {
-    r = fmin(r, maxValue);
-    g = fmin(g, maxValue);
-    b = fmin(b, maxValue);
+#else
+template<>
+TripleT<float>::TripleT(json const &node) {
+    setFromJson(*this, node);
 }
+#endif
 
-// --- Free Operators ----------------------------------------------------------
-
-// NOTE: no Triple:: needed!
-
-Triple operator+(double f, Triple const &t) {
-    return Triple(f + t.x, f + t.y, f + t.z);
-}
+// --- IO Operators ------------------------------------------------------------
 
-Triple operator-(double f, Triple const &t) {
-    return Triple(f - t.x, f - t.y, f - t.z);
+istream &operator>>(istream &is, Triple &t) {
+    return readTriple(is, t);
 }
 
-Triple operator*(double f, Triple const &t) {
-    return Triple(f * t.x, f * t.y, f * t.z);
+ostream &operator<<(ostream &os, Triple const &t) {
+    return writeTriple(os, t);
 }
 
-// --- IO Operators ------------------------------------------------------------
-
-istream &operator>>(istream &is, Triple &t) {
-    double x, y, z;
-    //  is >> x >> y >> z;      // is not guaranteed to work pre C++17
-    is >> x;
-    is >> y;
-    is >> z;
-    t.set(x, y, z);             // only assign if everything is extracted
-    return is;
+istream &operator>>(istream &is, Triplef &t) {
+    return readTriple(is, t);
 }
 
-ostream &operator<<(ostream &os, Triple const &t) {
-    // format: [x, y, z] (no newline)
-    os << '[' << t.x << ", " << t.y << ", " << t.z << ']';
-    return os;
+ostream &operator<<(ostream &os, Triplef const &t) {
+    return writeTriple(os, t);
 }
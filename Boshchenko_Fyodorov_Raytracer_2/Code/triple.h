@@ -3,102 +3,446 @@
 
 #include "json/json_fwd.h"
 
+#include <cmath>
 #include <iosfwd>
 
+#if defined(__SSE2__)
+#define RAY_SSE_TRIPLE 1
+#include <emmintrin.h>
+#endif
+
+/**
+ * Three components of type T, used for colors, points and vectors. All
+ * operators are defined inline here, so the vector arithmetic in the hot
+ * paths compiles down to plain arithmetic instead of function calls.
+ *
+ * The renderer computes in double (Triple); the float version (Triplef)
+ * halves storage where single precision is exact or good enough, e.g. mesh
+ * vertices. With SSE2 the float version keeps its components in one
+ * 128-bit register; the fourth lane is padding that no result depends on.
+ */
+template<typename T>
+class TripleT;
+
 // Color, Point and Vector are all Triples (name them so)
-class Triple;
+typedef TripleT<double> Triple;
 
 typedef Triple Color;
 typedef Triple Point;
 typedef Triple Vector;
 
-class Triple {
+typedef TripleT<float> Triplef;
+
+typedef Triplef Colorf;
+typedef Triplef Pointf;
+typedef Triplef Vectorf;
+
+template<typename T>
+class TripleT {
 public:
 // --- data members ------------------------------------------------------------
 
     // union to acces the same elements by
     // x, y, z, or r, g, b or data[index]
     union {
-        double data[3];
+        T data[3];
         struct {
-            double x;
-            double y;
-            double z;
+            T x;
+            T y;
+            T z;
         };
         struct {
-            double r;
-            double g;
-            double b;
+            T r;
+            T g;
+            T b;
         };
     };
 
 // --- Constructors ------------------------------------------------------------
 
-    explicit Triple(double X = 0, double Y = 0, double Z = 0);
+    explicit TripleT(T X = 0, T Y = 0, T Z = 0)
+            :
+            x(X),
+            y(Y),
+            z(Z) {}
+
+    // conversion between precisions
+    template<typename U>
+    explicit TripleT(TripleT<U> const &t)
+            :
+            TripleT(static_cast<T>(t.x), static_cast<T>(t.y), static_cast<T>(t.z)) {}
 
-    explicit Triple(nlohmann::json const &node);    // json -> Triple
+    explicit TripleT(nlohmann::json const &node);    // json -> Triple
 
 // --- Operators ---------------------------------------------------------------
 
-    Triple operator+(Triple const &t) const;// add two triples
-    Triple operator+(double f) const;       // add a value to each member
-    // of a triple
-    Triple operator-() const;               // negate
-    Triple operator-(Triple const &t) const;// subtract two triples
-    Triple operator-(double f) const;       // subtract a value from each
-    // member
+    TripleT operator+(TripleT const &t) const {     // add two triples
+        return TripleT(x + t.x, y + t.y, z + t.z);
+    }
 
-    Triple operator*(Triple const &t) const;// memberwise multiplication
-    Triple operator*(double f) const;       // multiply each member with a
-    // value
-    Triple operator/(double f) const;       // divide each member by a value
+    TripleT operator+(T f) const {                  // add a value to each member of a triple
+        return TripleT(x + f, y + f, z + f);
+    }
 
-// --- Compound operators ------------------------------------------------------
+    TripleT operator-() const {                     // negate
+        return TripleT(-x, -y, -z);
+    }
+
+    TripleT operator-(TripleT const &t) const {     // subtract two triples
+        return TripleT(x - t.x, y - t.y, z - t.z);
+    }
 
-    Triple &operator+=(Triple const &t);
+    TripleT operator-(T f) const {                  // subtract a value from each member
+        return TripleT(x - f, y - f, z - f);
+    }
 
-    Triple &operator+=(double f);
+    TripleT operator*(TripleT const &t) const {     // memberwise multiplication
+        return TripleT(x * t.x, y * t.y, z * t.z);
+    }
 
-    Triple &operator-=(Triple const &t);
+    TripleT operator*(T f) const {                  // multiply each member with a value
+        return TripleT(x * f, y * f, z * f);
+    }
 
-    Triple &operator-=(double f);
+    TripleT operator/(T f) const {                  // divide each member by a value
+        T invf = 1 / f;
+        return TripleT(x * invf, y * invf, z * invf);
+    }
 
-    Triple &operator*=(double f);
+// --- Compound operators ------------------------------------------------------
 
-    Triple &operator/=(double f);
+    TripleT &operator+=(TripleT const &t) {
+        x += t.x;
+        y += t.y;
+        z += t.z;
+        return *this;
+    }
+
+    TripleT &operator+=(T f) {
+        x += f;
+        y += f;
+        z += f;
+        return *this;
+    }
+
+    TripleT &operator-=(TripleT const &t) {
+        x -= t.x;
+        y -= t.y;
+        z -= t.z;
+        return *this;
+    }
+
+    TripleT &operator-=(T f) {
+        x -= f;
+        y -= f;
+        z -= f;
+        return *this;
+    }
+
+    TripleT &operator*=(T f) {
+        x *= f;
+        y *= f;
+        z *= f;
+        return *this;
+    }
+
+    TripleT &operator/=(T f) {
+        T invf = 1 / f;
+        x *= invf;
+        y *= invf;
+        z *= invf;
+        return *this;
+    }
 
 // --- Vector Operators --------------------------------------------------------
 
-    double dot(Triple const &t) const;      // dot product
-    Triple cross(Triple const &t) const;    // cross product
+    T dot(TripleT const &t) const {                 // dot product
+        return x * t.x + y * t.y + z * t.z;
+    }
+
+    TripleT cross(TripleT const &t) const {         // cross product
+        return TripleT(y * t.z - z * t.y,
+                       z * t.x - x * t.z,
+                       x * t.y - y * t.x);
+    }
 
-    double length() const;
+    T length() const {
+        return std::sqrt(length_2());
+    }
 
-    double length_2() const;                // length squared
+    T length_2() const {                            // length squared
+        return x * x + y * y + z * z;
+    }
 
     // NOTE: normalized return a COPY, normalize does NOT
-    Triple normalized() const;              // normalized COPY
-    void normalize();                       // normalize THIS
+    TripleT normalized() const {                    // normalized COPY
+        return (*this) / length();
+    }
+
+    void normalize() {                              // normalize THIS
+        T invlen = 1 / length();
+        x *= invlen;
+        y *= invlen;
+        z *= invlen;
+    }
+
+// --- Fused operations --------------------------------------------------------
+
+    // Compound shading expressions in one pass without Triple temporaries.
+    // Each rounds exactly like the expression it replaces.
+
+    TripleT &addScaled(T f, TripleT const &a, T g = 1, T h = 1) {      // += f * a * g * h
+        x += f * a.x * g * h;
+        y += f * a.y * g * h;
+        z += f * a.z * g * h;
+        return *this;
+    }
+
+    TripleT &addProduct(T f, TripleT const &a, TripleT const &b, T g = 1) {    // += f * a * b * g
+        x += f * a.x * b.x * g;
+        y += f * a.y * b.y * g;
+        z += f * a.z * b.z * g;
+        return *this;
+    }
+
+    // d - 2 * d.dot(n) * n: d mirrored at the plane with unit normal n
+    static TripleT reflect(TripleT const &d, TripleT const &n) {
+        T k = 2 * d.dot(n);
+        return TripleT(d.x - k * n.x, d.y - k * n.y, d.z - k * n.z);
+    }
 
 // --- Color functions ---------------------------------------------------------
 
-    void set(double f);                     // set all values to f
-    void set(double f, double maxValue);    // set all values to f / maxVal
-    void set(double red, double green, double blue);
+    void set(T f) {                                 // set all values to f
+        r = f;
+        g = f;
+        b = f;
+    }
 
-    void set(double red, double green, double blue, double maxValue);
+    void set(T f, T maxValue) {                     // set all values to f / maxVal
+        set(f / maxValue);
+    }
 
-    void clamp(double maxValue = 1.0);      // clamp: fmin(val, maxValue)
+    void set(T red, T green, T blue) {
+        r = red;
+        g = green;
+        b = blue;
+    }
 
-};
+    void set(T red, T green, T blue, T maxValue) {
+        set(red / maxValue, green / maxValue, blue / maxValue);
+    }
+
+    void clamp(T maxValue = 1) {                    // clamp: fmin(val, maxValue)
+        r = std::fmin(r, maxValue);
+        g = std::fmin(g, maxValue);
+        b = std::fmin(b, maxValue);
+    }
 
 // --- Free Operators ----------------------------------------------------------
 
-Triple operator+(double f, Triple const &t);
+    friend TripleT operator+(T f, TripleT const &t) {
+        return TripleT(f + t.x, f + t.y, f + t.z);
+    }
 
-Triple operator-(double f, Triple const &t);
+    friend TripleT operator-(T f, TripleT const &t) {
+        return TripleT(f - t.x, f - t.y, f - t.z);
+    }
 
-Triple operator*(double f, Triple const &t);
+    friend TripleT operator*(T f, TripleT const &t) {
+        return TripleT(f * t.x, f * t.y, f * t.z);
+    }
+};
+
+// The json constructors are defined in triple.cpp
+template<>
+TripleT<double>::TripleT(nlohmann::json const &node);
+
+#ifndef RAY_SSE_TRIPLE
+template<>
+TripleT<float>::TripleT(nlohmann::json const &node);
+#endif
+
+#ifdef RAY_SSE_TRIPLE
+
+// Single precision triple in an SSE register; lane 3 is padding
+template<>
+class TripleT<float> {
+public:
+    union {
+        __m128 v;
+        float data[3];
+        struct {
+            float x;
+            float y;
+            float z;
+        };
+        struct {
+            float r;
+            float g;
+            float b;
+        };
+    };
+
+    explicit TripleT(float X = 0, float Y = 0, float Z = 0)
+            :
+            v(_mm_setr_ps(X, Y, Z, 0.0f)) {}
+
+    explicit TripleT(__m128 lanes)
+            :
+            v(lanes) {}
+
+    template<typename U>
+    explicit TripleT(TripleT<U> const &t)
+            :
+            TripleT(static_cast<float>(t.x), static_cast<float>(t.y), static_cast<float>(t.z)) {}
+
+    explicit TripleT(nlohmann::json const &node);
+
+    TripleT operator+(TripleT const &t) const {
+        return TripleT(_mm_add_ps(v, t.v));
+    }
+
+    TripleT operator+(float f) const {
+        return TripleT(_mm_add_ps(v, _mm_set1_ps(f)));
+    }
+
+    TripleT operator-() const {
+        return TripleT(_mm_sub_ps(_mm_setzero_ps(), v));
+    }
+
+    TripleT operator-(TripleT const &t) const {
+        return TripleT(_mm_sub_ps(v, t.v));
+    }
+
+    TripleT operator-(float f) const {
+        return TripleT(_mm_sub_ps(v, _mm_set1_ps(f)));
+    }
+
+    TripleT operator*(TripleT const &t) const {
+        return TripleT(_mm_mul_ps(v, t.v));
+    }
+
+    TripleT operator*(float f) const {
+        return TripleT(_mm_mul_ps(v, _mm_set1_ps(f)));
+    }
+
+    TripleT operator/(float f) const {
+        return (*this) * (1.0f / f);
+    }
+
+    TripleT &operator+=(TripleT const &t) {
+        v = _mm_add_ps(v, t.v);
+        return *this;
+    }
+
+    TripleT &operator+=(float f) {
+        v = _mm_add_ps(v, _mm_set1_ps(f));
+        return *this;
+    }
+
+    TripleT &operator-=(TripleT const &t) {
+        v = _mm_sub_ps(v, t.v);
+        return *this;
+    }
+
+    TripleT &operator-=(float f) {
+        v = _mm_sub_ps(v, _mm_set1_ps(f));
+        return *this;
+    }
+
+    TripleT &operator*=(float f) {
+        v = _mm_mul_ps(v, _mm_set1_ps(f));
+        return *this;
+    }
+
+    TripleT &operator/=(float f) {
+        return (*this) *= 1.0f / f;
+    }
+
+    float dot(TripleT const &t) const {
+        // Horizontal sum of lanes 0-2, lane 3 is left out
+        __m128 m = _mm_mul_ps(v, t.v);
+        __m128 y_lane = _mm_shuffle_ps(m, m, _MM_SHUFFLE(1, 1, 1, 1)),
+                z_lane = _mm_shuffle_ps(m, m, _MM_SHUFFLE(2, 2, 2, 2));
+        return _mm_cvtss_f32(_mm_add_ss(_mm_add_ss(m, y_lane), z_lane));
+    }
+
+    TripleT cross(TripleT const &t) const {
+        // (y, z, x) * (t.z, t.x, t.y) - (z, x, y) * (t.y, t.z, t.x)
+        __m128 a_yzx = _mm_shuffle_ps(v, v, _MM_SHUFFLE(3, 0, 2, 1)),
+                b_yzx = _mm_shuffle_ps(t.v, t.v, _MM_SHUFFLE(3, 0, 2, 1));
+        __m128 c = _mm_sub_ps(_mm_mul_ps(v, b_yzx), _mm_mul_ps(a_yzx, t.v));
+        return TripleT(_mm_shuffle_ps(c, c, _MM_SHUFFLE(3, 0, 2, 1)));
+    }
+
+    float length() const {
+        return std::sqrt(length_2());
+    }
+
+    float length_2() const {
+        return dot(*this);
+    }
+
+    TripleT normalized() const {
+        return (*this) / length();
+    }
+
+    void normalize() {
+        *this = normalized();
+    }
+
+    TripleT &addScaled(float f, TripleT const &a, float g = 1, float h = 1) {
+        __m128 term = _mm_mul_ps(_mm_mul_ps(_mm_mul_ps(_mm_set1_ps(f), a.v), _mm_set1_ps(g)), _mm_set1_ps(h));
+        v = _mm_add_ps(v, term);
+        return *this;
+    }
+
+    TripleT &addProduct(float f, TripleT const &a, TripleT const &b, float g = 1) {
+        __m128 term = _mm_mul_ps(_mm_mul_ps(_mm_mul_ps(_mm_set1_ps(f), a.v), b.v), _mm_set1_ps(g));
+        v = _mm_add_ps(v, term);
+        return *this;
+    }
+
+    static TripleT reflect(TripleT const &d, TripleT const &n) {
+        return TripleT(_mm_sub_ps(d.v, _mm_mul_ps(_mm_set1_ps(2 * d.dot(n)), n.v)));
+    }
+
+    void set(float f) {
+        v = _mm_setr_ps(f, f, f, 0.0f);
+    }
+
+    void set(float f, float maxValue) {
+        set(f / maxValue);
+    }
+
+    void set(float red, float green, float blue) {
+        v = _mm_setr_ps(red, green, blue, 0.0f);
+    }
+
+    void set(float red, float green, float blue, float maxValue) {
+        set(red / maxValue, green / maxValue, blue / maxValue);
+    }
+
+    void clamp(float maxValue = 1) {
+        // minps returns its second operand for NaN lanes, just like fmin
+        v = _mm_min_ps(v, _mm_set1_ps(maxValue));
+    }
+
+    friend TripleT operator+(float f, TripleT const &t) {
+        return TripleT(_mm_add_ps(_mm_set1_ps(f), t.v));
+    }
+
+    friend TripleT operator-(float f, TripleT const &t) {
+        return TripleT(_mm_sub_ps(_mm_set1_ps(f), t.v));
+    }
+
+    friend TripleT operator*(float f, TripleT const &t) {
+        return TripleT(_mm_mul_ps(_mm_set1_ps(f), t.v));
+    }
+};
+
+#endif
 
 // --- IO Operators ------------------------------------------------------------
 
@@ -106,4 +450,8 @@ std::istream &operator>>(std::istream &is, Triple &t);
 
 std::ostream &operator<<(std::ostream &os, Triple const &t);
 
+std::istream &operator>>(std::istream &is, Triplef &t);
+
+std::ostream &operator<<(std::ostream &os, Triplef const &t);
+
 #endif
@@ -0,0 +1,334 @@
+/**
+ * Golden-image regression test.
+ *
+ * Renders every scene of the given Scenes folders and compares the result
+ * with its reference image: <scene>_reference.png next to the scene file
+ * when there is one, otherwise <golden>/<project>/<scene>.png, where
+ * <project> is the folder that holds Scenes. For every scene it reports
+ * the PSNR and the largest channel error against the reference, the render
+ * time (best of --runs) and the rays traced per second. The test fails
+ * when a PSNR drops below --min-psnr or a render takes more than
+ * (1 + --time-tolerance) times the budget stored in <golden>/budgets.json
+ * plus --time-slack seconds, which keeps tiny scenes from failing on noise.
+ *
+ * Scenes listed in <golden>/references.json are instead compared with a
+ * shared reference, e.g. a render with many samples per pixel, and with
+ * their own PSNR limit:
+ *
+ *     {"<project>/<scene>": {"reference": "<project>/<image>", "min_psnr": 36}}
+ *
+ * so that renders with different sample patterns and counts can be held
+ * against the same ground truth; the samples per pixel are reported too.
+ *
+ * --update stores the current images and times as the new references
+ * (shipped *_reference.png files and shared references are never overwritten).
+ */
+
+#include "image.h"
+#include "raytracer.h"
+#include "scene.h"
+#include "stats.h"
+#include "json/json.h"
+#include "lode/lodepng.h"
+
+#include <dirent.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <string>
+#include <vector>
+
+using namespace std;
+using json = nlohmann::json;
+
+namespace {
+
+struct Options {
+    vector<string> scene_dirs;
+    string golden_dir;
+    string report;              // optional json file with the results
+    double min_psnr = 40.0;
+    double time_tolerance = 1.0;
+    double time_slack = 0.05;
+    unsigned runs = 3;
+    unsigned threads = 1;
+    bool update = false;
+};
+
+struct Result {
+    string key;                 // <project>/<scene>
+    double psnr = 0;
+    double min_psnr = 0;
+    int max_error = 0;
+    double samples_per_pixel = 0;
+    double seconds = 0;
+    double budget = 0;          // 0: no budget yet
+    double rays_per_second = 0;
+    bool passed = true;
+    string message;
+};
+
+string absolutePath(string const &path) {
+    char buffer[PATH_MAX];
+    return realpath(path.c_str(), buffer) ? string(buffer) : path;
+}
+
+string baseName(string const &path) {
+    size_t slash = path.find_last_of('/');
+    return slash == string::npos ? path : path.substr(slash + 1);
+}
+
+string parentDir(string const &path) {
+    size_t slash = path.find_last_of('/');
+    return slash == string::npos ? "." : path.substr(0, slash);
+}
+
+bool fileExists(string const &path) {
+    struct stat info;
+    return stat(path.c_str(), &info) == 0;
+}
+
+vector<string> sceneFiles(string const &dir) {
+    vector<string> files;
+    if (DIR *handle = opendir(dir.c_str())) {
+        while (dirent *entry = readdir(handle)) {
+            string name = entry->d_name;
+            if (name.size() > 5 && name.compare(name.size() - 5, 5, ".json") == 0) {
+                files.push_back(dir + "/" + name);
+            }
+        }
+        closedir(handle);
+    }
+    sort(files.begin(), files.end());
+    return files;
+}
+
+// The bytes write_png would store, without the alpha channel
+vector<unsigned char> toRGB(Image const &img) {
+    vector<unsigned char> rgb;
+    rgb.reserve(3 * img.size());
+    for (unsigned y = 0; y < img.height(); ++y) {
+        for (unsigned x = 0; x < img.width(); ++x) {
+            Pixel const &pixel = img(x, y);
+            rgb.push_back(static_cast<unsigned char>(pixel.r * 255.0));
+            rgb.push_back(static_cast<unsigned char>(pixel.g * 255.0));
+            rgb.push_back(static_cast<unsigned char>(pixel.b * 255.0));
+        }
+    }
+    return rgb;
+}
+
+// PSNR in dB (infinity for identical images) and the largest channel difference
+void compare(vector<unsigned char> const &image, vector<unsigned char> const &reference,
+             double &psnr, int &max_error) {
+    double squared = 0;
+    max_error = 0;
+    for (size_t idx = 0; idx < image.size(); ++idx) {
+        int error = abs(int(image[idx]) - int(reference[idx]));
+        squared += error * error;
+        max_error = max(max_error, error);
+    }
+    double mse = squared / image.size();
+    psnr = mse > 0 ? 10 * log10(255.0 * 255.0 / mse) : numeric_limits<double>::infinity();
+}
+
+Result runScene(string const &filename, Options const &options, json &budgets, json const &references) {
+    string project = baseName(parentDir(parentDir(filename)));
+    string scene = baseName(filename);
+    scene.erase(scene.size() - 5);
+
+    Result result;
+    result.key = project + "/" + scene;
+    if (budgets.find(result.key) != budgets.end()) {
+        result.budget = budgets[result.key];
+    }
+    result.min_psnr = options.min_psnr;
+    string shared;
+    if (references.find(result.key) != references.end()) {
+        json const &entry = references[result.key];
+        shared = entry.value("reference", "");
+        result.min_psnr = entry.value("min_psnr", options.min_psnr);
+    }
+
+    // Scenes refer to their textures and meshes as ../Scenes/..., so they
+    // are read from within their own folder, and every scene starts from
+    // the same random() state as a fresh ray process would
+    char cwd[PATH_MAX];
+    if (!getcwd(cwd, sizeof cwd) || chdir(parentDir(filename).c_str()) != 0) {
+        result.passed = false;
+        result.message = "cannot enter the scene folder";
+        return result;
+    }
+    srandom(1);
+    Raytracer raytracer;
+    streambuf *out = cout.rdbuf(nullptr);
+    bool ok = raytracer.readScene(filename);
+    cout.rdbuf(out);
+    if (chdir(cwd) != 0 || !ok) {
+        result.passed = false;
+        result.message = "cannot read the scene";
+        return result;
+    }
+    raytracer.setThreads(options.threads);
+
+    Scene const &scene_data = raytracer.getScene();
+    Tile region = scene_data.region();
+    Image img(region.x1 - region.x0, region.y1 - region.y0);
+    result.seconds = numeric_limits<double>::infinity();
+    for (unsigned run = 0; run < options.runs; ++run) {
+        Stopwatch watch;
+        RenderCounters counters = scene_data.render(img);
+        double seconds = watch.seconds();
+        if (seconds < result.seconds) {
+            result.seconds = seconds;
+            result.rays_per_second = (counters.primary_rays + counters.shadow_rays + counters.reflection_rays) /
+                                     seconds;
+            result.samples_per_pixel = double(counters.primary_rays) / img.size();
+        }
+    }
+    vector<unsigned char> rgb = toRGB(img);
+
+    string shipped = parentDir(filename) + "/" + scene + "_reference.png";
+    string golden = options.golden_dir + "/" + project + "/" + scene + ".png";
+    string reference_file = !shared.empty() ? options.golden_dir + "/" + shared + ".png"
+                                            : fileExists(shipped) ? shipped : golden;
+
+    if (options.update) {
+        if (reference_file == golden) {
+            mkdir((options.golden_dir + "/" + project).c_str(), 0755);
+            if (lodepng::encode(golden, rgb, img.width(), img.height(), LCT_RGB) != 0) {
+                result.passed = false;
+                result.message = "cannot write " + golden;
+            }
+        }
+        budgets[result.key] = result.seconds;
+        result.budget = result.seconds;
+    }
+
+    vector<unsigned char> reference;
+    unsigned width = 0, height = 0;
+    if (lodepng::decode(reference, width, height, reference_file, LCT_RGB) != 0) {
+        result.passed = false;
+        result.message = "no reference image " + reference_file;
+        return result;
+    }
+    if (width != img.width() || height != img.height()) {
+        result.passed = false;
+        result.message = "the reference image has a different size";
+        return result;
+    }
+    compare(rgb, reference, result.psnr, result.max_error);
+    if (result.psnr < result.min_psnr) {
+        result.passed = false;
+        result.message = "image quality dropped";
+    } else if (result.budget > 0 &&
+               result.seconds > (1 + options.time_tolerance) * result.budget + options.time_slack) {
+        result.passed = false;
+        result.message = "render time regressed";
+    }
+    return result;
+}
+
+bool parseOptions(int argc, char *argv[], Options &options) {
+    for (int idx = 1; idx < argc; ++idx) {
+        string arg = argv[idx];
+        bool has_value = idx + 1 < argc;
+        if (arg == "--scenes" && has_value) {
+            options.scene_dirs.push_back(absolutePath(argv[++idx]));
+        } else if (arg == "--golden" && has_value) {
+            options.golden_dir = absolutePath(argv[++idx]);
+        } else if (arg == "--report" && has_value) {
+            options.report = argv[++idx];
+        } else if (arg == "--min-psnr" && has_value) {
+            options.min_psnr = stod(argv[++idx]);
+        } else if (arg == "--time-tolerance" && has_value) {
+            options.time_tolerance = stod(argv[++idx]);
+        } else if (arg == "--time-slack" && has_value) {
+            options.time_slack = stod(argv[++idx]);
+        } else if (arg == "--runs" && has_value) {
+            options.runs = max(1, stoi(argv[++idx]));
+        } else if (arg == "--threads" && has_value) {
+            options.threads = static_cast<unsigned>(stoi(argv[++idx]));
+        } else if (arg == "--update") {
+            options.update = true;
+        } else {
+            return false;
+        }
+    }
+    return !options.scene_dirs.empty() && !options.golden_dir.empty();
+}
+
+}
+
+int main(int argc, char *argv[]) {
+    Options options;
+    if (!parseOptions(argc, argv, options)) {
+        cerr << "Usage: " << argv[0] << " --golden dir --scenes dir [--scenes dir ...] [--min-psnr dB]"
+             << " [--time-tolerance fraction] [--time-slack seconds] [--runs n] [--threads n] [--report results.json] [--update]\n";
+        return 2;
+    }
+
+    string budget_file = options.golden_dir + "/budgets.json";
+    json budgets = json::object();
+    ifstream budget_in(budget_file);
+    if (budget_in) {
+        budget_in >> budgets;
+    }
+    json references = json::object();
+    ifstream references_in(options.golden_dir + "/references.json");
+    if (references_in) {
+        references_in >> references;
+    }
+
+    vector<Result> results;
+    for (string const &dir : options.scene_dirs) {
+        for (string const &filename : sceneFiles(dir)) {
+            results.push_back(runScene(filename, options, budgets, references));
+        }
+    }
+
+    json report = json::array();
+    bool passed = true;
+    printf("%-74s %8s %5s %9s %9s %12s %9s\n", "scene", "PSNR", "max", "seconds", "budget", "rays/s",
+           "samples");
+    for (Result const &result : results) {
+        printf("%-74s %8.2f %5d %9.4f %9.4f %12.0f %9.2f %s %s\n", result.key.c_str(), result.psnr,
+               result.max_error, result.seconds, result.budget, result.rays_per_second, result.samples_per_pixel,
+               result.passed ? "ok" : "FAILED", result.message.c_str());
+        passed = passed && result.passed;
+        report.push_back({
+                {"scene",           result.key},
+                {"psnr",            std::isinf(result.psnr) ? json("inf") : json(result.psnr)},
+                {"min_psnr",        result.min_psnr},
+                {"max_error",       result.max_error},
+                {"seconds",         result.seconds},
+                {"budget",          result.budget},
+                {"rays_per_second", result.rays_per_second},
+                {"samples_per_pixel", result.samples_per_pixel},
+                {"passed",          result.passed}
+        });
+    }
+
+    if (options.update) {
+        ofstream budget_out(budget_file);
+        budget_out << setw(4) << budgets << '\n';
+    }
+    if (!options.report.empty()) {
+        ofstream report_out(options.report);
+        report_out << setw(4) << report << '\n';
+    }
+    if (results.empty()) {
+        cerr << "No scenes found.\n";
+        return 1;
+    }
+    return passed ? 0 : 1;
+}
@@ -0,0 +1,221 @@
+/**
+ * OBJ loader test: the MAPPED parser must give exactly the data of the
+ * STREAM parser, and reject the files that one rejects.
+ *
+ * Loads every OBJ named on the command line and a few generated files with
+ * both parsers and compares vertex_data(), coordinate_data() and
+ * coordinate_indices() bit for bit. The generated files cover CRLF line
+ * ends, '+' signs, hex floats, infinities and NaNs, numbers out of range,
+ * relative (negative) face indices, comments, repeated spaces, polygons, "vt"
+ * lines after the first faces, and one file large enough to be parsed in
+ * several chunks.
+ *
+ * The generated files are also compiled into mesh files (meshfile.h), which
+ * must read back as the same data, and a Mesh from a mesh file must have the
+ * vertices, triangles and BVH of one parsed from the OBJ. A mesh file stays
+ * valid when only the modification time of its OBJ changes and is rejected
+ * when the bytes change.
+ *
+ *     ./ray_objloader [file.obj ...]
+ */
+
+#include "mesh.h"
+#include "meshfile.h"
+#include "objloader.h"
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstdio>
+#include <cstring>
+#include <exception>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+namespace {
+
+bool sameVertices(vector<Vertex> const &a, vector<Vertex> const &b) {
+    return a.size() == b.size() && (a.empty() || memcmp(a.data(), b.data(), a.size() * sizeof(Vertex)) == 0);
+}
+
+bool sameData(OBJLoader const &a, OBJLoader const &b) {
+    return a.hasTexCoords() == b.hasTexCoords() && sameVertices(a.vertex_data(), b.vertex_data()) &&
+           sameVertices(a.coordinate_data(), b.coordinate_data()) &&
+           a.coordinate_indices() == b.coordinate_indices();
+}
+
+template<typename T>
+bool samePoint(TripleT<T> const &a, TripleT<T> const &b) {
+    return a.x == b.x && a.y == b.y && a.z == b.z;
+}
+
+bool sameBVH(BVH const &a, BVH const &b) {
+    if (a.order() != b.order() || a.getNodes().size() != b.getNodes().size()) {
+        return false;
+    }
+    for (size_t idx = 0; idx < a.getNodes().size(); ++idx) {
+        BVH::Node const &x = a.getNodes()[idx], &y = b.getNodes()[idx];
+        if (!samePoint(x.box.min, y.box.min) || !samePoint(x.box.max, y.box.max) || x.first != y.first ||
+            x.count != y.count || x.axis != y.axis) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// A mesh file written from the stream parser must read back as the same data
+bool checkMeshFile(string const &filename, string const &name) {
+    unique_ptr<OBJLoader> stream;
+    try {
+        stream.reset(new OBJLoader(filename, OBJLoader::STREAM));
+    } catch (exception const &) {
+        return true;    // nothing to compile
+    }
+    FileStamp stamp;
+    MeshFile::Contents contents;
+    vector<uint32_t> indices;
+    MeshFile file;
+    bool ok = FileStamp::read(filename, stamp) && stream->meshFileContents(contents, indices) &&
+              MeshFile::write(filename, stamp, contents) && file.open(filename, stamp) &&
+              sameData(OBJLoader(file), *stream);
+    remove(MeshFile::path(filename).c_str());
+    printf("%-48s %17s  %s\n", (name + " (mesh file)").c_str(), "", ok ? "ok" : "DIFFERENT");
+    return ok;
+}
+
+// Compares both parsers on one file, the mapped one on the given number of threads
+bool check(string const &filename, string const &name, unsigned threads) {
+    unique_ptr<OBJLoader> stream, mapped;
+    try {
+        stream.reset(new OBJLoader(filename, OBJLoader::STREAM));
+    } catch (exception const &) {
+    }
+    try {
+        mapped.reset(new OBJLoader(filename, OBJLoader::MAPPED, threads));
+    } catch (exception const &) {
+    }
+    if (!stream || !mapped) {
+        printf("%-48s %17s  %s\n", name.c_str(), "rejected", !stream && !mapped ? "ok" : "DIFFERENT");
+        return !stream && !mapped;
+    }
+    bool ok = sameData(*mapped, *stream);
+    printf("%-48s %8zu vertices  %s\n", name.c_str(), stream->vertex_data().size(), ok ? "ok" : "DIFFERENT");
+    return ok;
+}
+
+bool checkText(string const &name, string const &text, unsigned threads) {
+    string filename = "objloader_test_" + to_string(getpid()) + ".obj";
+    ofstream(filename, ios::binary) << text;
+    bool ok = check(filename, name, threads);
+    ok = checkMeshFile(filename, name) && ok;
+    remove(filename.c_str());
+    return ok;
+}
+
+// A Mesh with mesh files on writes one on its first load and reads it on the next
+bool checkCompiledMesh(string const &text) {
+    string filename = "objloader_test_" + to_string(getpid()) + ".obj";
+    ofstream(filename, ios::binary) << text;
+    Mesh::setMeshFiles(true);
+    Mesh parsed(filename), compiled(filename);
+    bool ok = !parsed.getBVH() || sameBVH(*parsed.getBVH(), parsed.buildBVH());
+    ok = ok && compiled.getBVH() && compiled.getVertices().size() == parsed.getVertices().size() &&
+         compiled.getIndices() == parsed.getIndices() && sameBVH(*compiled.getBVH(), parsed.buildBVH());
+    for (size_t idx = 0; ok && idx < parsed.getVertices().size(); ++idx) {
+        ok = samePoint(compiled.getVertices()[idx], parsed.getVertices()[idx]);
+    }
+    printf("%-48s %8u triangles %s\n", "Mesh from a mesh file", compiled.numTriangles(), ok ? "ok" : "DIFFERENT");
+
+    // Only touched: the hash of the bytes still matches, and the new time is recorded
+    FileStamp stamp;
+    struct timespec times[2] = {{0, UTIME_OMIT}, {12345, 0}};
+    MeshFile touched_file;
+    bool touched = utimensat(AT_FDCWD, filename.c_str(), times, 0) == 0 && FileStamp::read(filename, stamp) &&
+                   MeshFile().open(filename, stamp) && touched_file.open(filename, stamp) &&
+                   touched_file.header().obj_mtime == stamp.mtime;
+    printf("%-48s %17s  %s\n", "mesh file of a touched OBJ", "", touched ? "ok" : "REJECTED");
+
+    // Same size, other bytes
+    string changed = text;
+    changed[changed.find("v ") + 2] = '7';
+    ofstream(filename, ios::binary) << changed;
+    bool stale = FileStamp::read(filename, stamp) && !MeshFile().open(filename, stamp);
+    printf("%-48s %17s  %s\n", "mesh file of a changed OBJ", "", stale ? "ok" : "ACCEPTED");
+
+    Mesh::setMeshFiles(false);
+    remove(MeshFile::path(filename).c_str());
+    remove(filename.c_str());
+    return ok && touched && stale;
+}
+
+// A quad strip of n quads, the faces written as polygons when polygons is set
+string strip(size_t n, size_t base, bool polygons) {
+    string text;
+    for (size_t idx = 0; idx <= n; ++idx) {
+        text += "v " + to_string(idx * 0.25) + " 0 -" + to_string(idx) + "e-2\n";
+        text += "v  +" + to_string(idx * 0.25) + " 1 0.5\r\n";
+    }
+    for (size_t idx = 0; idx < n; ++idx) {
+        string a = to_string(base + 2 * idx + 1), b = to_string(base + 2 * idx + 2),
+                c = to_string(base + 2 * idx + 3), d = to_string(base + 2 * idx + 4);
+        if (polygons) {
+            text += "f " + a + "/1/1 " + c + "/2/1 " + d + "/2/1 " + b + "/1/1\n";
+        } else {
+            text += "f " + a + "/1/1 " + c + "/2/1 " + d + "/2/1\r\n";
+            text += "f " + a + "/1/1  " + d + "/2/1 " + b + "/1/1 \n";
+        }
+    }
+    return text;
+}
+
+}
+
+int main(int argc, char *argv[]) {
+    bool ok = true;
+    for (int idx = 1; idx < argc; ++idx) {
+        ok = check(argv[idx], argv[idx], 0) && ok;
+    }
+
+    // No empty lines, the stream parser does not expect them
+    string header = "# generated\nmtllib none.mtl\nvn 0 0 1\nvn +0.5 -0.5 0.7071\r\n";
+    ok = checkText("triangles", header + strip(8, 0, false), 1) && ok;
+    ok = checkText("polygons", header + strip(8, 0, true), 1) && ok;
+    ok = checkText("untextured faces", header + "v 0 0 0\nv 1 0 0\nv 0 1 0\nf 1//1 2//1 3//2\n", 1) && ok;
+    ok = checkText("texture coordinates after faces",
+                   header + strip(4, 0, false) + "vt 0.25 0.75\nvt 1 +1e0\n" + strip(4, 10, false), 1) && ok;
+    ok = checkText("no trailing newline", header + "vt 0 1\nv 0 0 0\nv 1 0 0\nv 0 1 0\nf 1/1/1 2/1/1 3/1/1", 1) && ok;
+    ok = checkText("empty file", "", 1) && ok;
+    ok = checkText("missing texture index", header + "vt 0 1\nv 0 0 0\nf 1//1 1//1 1//1\n", 1) && ok;
+    ok = checkText("missing normal index", header + "v 0 0 0\nf 1/1 1/1 1/1\n", 1) && ok;
+    // Numbers in the forms stof() and stoul() accept beyond plain decimals, and those they reject
+    string face = "f 1/1/1 2/1/1 3/1/1\n";
+    ok = checkText("signs and hex floats", header + "vt +0 -0x.8p1\nv +1 -2 +3e-1\nv 0x1p3 -0X1.8P0 0x\n"
+                   "v 1.5abc 2\r 0x1g\n" + "f +1/+1/+2 2/1/1 +3/1/+1\n", 1) && ok;
+    ok = checkText("infinity and NaN", header + "vt 0 0\nv inf -Infinity +INF\nv nan -nan NaN(12)\nv 0 0 0\n" + face,
+                   1) && ok;
+    ok = checkText("subnormal number", header + "vt 0 0\nv 1e-40 0 0\nv 0 0 0\nv 0 0 0\n" + face, 1) && ok;
+    ok = checkText("number out of range", header + "vt 0 0\nv 1e50 0 0\nv 0 0 0\nv 0 0 0\n" + face, 1) && ok;
+    ok = checkText("index out of range", header + "vt 0 0\nv 0 0 0\nf 99999999999999999999999/1/1 1/1/1 1/1/1\n",
+                   1) && ok;
+    ok = checkText("relative face indices",
+                   header + "vt 0 0\nv 0 0 0\nv 0 0 0\nv 0 0 0\nf -3/-1/-1 -2/-1/-1 -1/-1/-1\n", 1) && ok;
+    ok = checkText("relative texture index", header + "vt 0 0\nv 0 0 0\nf 1/-1/1 1/1/1 1/1/1\n", 1) && ok;
+    ok = checkText("relative texture index before \"vt\"", header + "v 0 0 0\nf 1/-1/1 1/1/1 1/1/1\n", 1) && ok;
+
+    // Several MB, so that the mapped parser splits it; the first "vt" is in a later chunk
+    string large = header + strip(40000, 0, false) + "vt 0 0\nvt 1 1\n";
+    large += strip(40000, 80002, true);
+    ok = checkText("chunks", large, 4) && ok;
+    ok = checkCompiledMesh(header + strip(2000, 0, false)) && ok;
+
+    if (!ok) {
+        cerr << "The mapped OBJ parser differs from the stream parser\n";
+    }
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,239 @@
+/**
+ * Triangle block test: the float block kernels must report every triangle
+ * that the exact double precision Triangle::distance hits, so that a mesh
+ * never loses a hit to them.
+ *
+ * Fills blocks with small triangles far away from the eye, slivers,
+ * triangles far away from the origin of the world, rays that graze the plane
+ * of their triangle and rays that start on a neighbouring triangle, aimed
+ * close to the edges. Every ray is tested against its block with every
+ * kernel the CPU supports, once with an unbounded t_max and once with a
+ * t_max just beyond each hit.
+ *
+ *     ./ray_triangleblock
+ */
+
+#include "triangleblock.h"
+#include "shapes/triangle.h"
+
+#include <cmath>
+#include <cstdio>
+#include <functional>
+#include <iostream>
+#include <limits>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+namespace {
+
+struct Case {
+    vector<Point> corners;      // three per triangle, at most TriangleBlock::WIDTH triangles
+    vector<Ray> rays;
+};
+
+struct Kernel {
+    char const *name;
+    TriangleBlockKernel kernel;
+};
+
+mt19937 rng(1);
+
+double uniform(double low, double high) {
+    return uniform_real_distribution<double>(low, high)(rng);
+}
+
+Vector randomDirection() {
+    Vector direction;
+    do {
+        direction = Vector(uniform(-1, 1), uniform(-1, 1), uniform(-1, 1));
+    } while (direction.length() < 0.1 || direction.length() > 1);
+    return direction.normalized();
+}
+
+// A point of triangle 'first' of a case close to one of its edges or corners
+Point nearEdge(Case const &test, size_t first) {
+    Point const &a = test.corners[first], &b = test.corners[first + 1], &c = test.corners[first + 2];
+    double u = uniform(0, 1), v = uniform(0, 1 - u), margin = uniform(-1e-6, 1e-6);
+    switch (rng() % 4) {
+        case 0:
+            u = margin;
+            break;
+        case 1:
+            v = margin;
+            break;
+        case 2:
+            v = 1 - u + margin;
+            break;
+        default:
+            break;   // inside
+    }
+    return a + u * (b - a) + v * (c - a);
+}
+
+// Eight triangles of about the given size around center, rays from eye at points near their edges
+Case cluster(Point const &center, double size, Point const &eye, size_t rays) {
+    Case test;
+    for (int triangle = 0; triangle < TriangleBlock::WIDTH; ++triangle) {
+        Point a = center + 2 * size * randomDirection();
+        test.corners.insert(test.corners.end(), {a, a + size * randomDirection(), a + size * randomDirection()});
+    }
+    for (size_t ray = 0; ray < rays; ++ray) {
+        Point aim = nearEdge(test, 3 * (rng() % TriangleBlock::WIDTH));
+        test.rays.push_back(Ray(eye, (aim - eye).normalized()));
+    }
+    return test;
+}
+
+Case slivers(size_t rays) {
+    Case test;
+    for (int triangle = 0; triangle < TriangleBlock::WIDTH; ++triangle) {
+        Point a = Point(0, 0, 0) + 0.5 * randomDirection();
+        Vector along = randomDirection(), across = along.cross(randomDirection()).normalized();
+        test.corners.insert(test.corners.end(), {a, a + along, a + 0.5 * along + uniform(1e-6, 1e-4) * across});
+    }
+    Point eye(3, -4, 12);
+    for (size_t ray = 0; ray < rays; ++ray) {
+        Point aim = nearEdge(test, 3 * (rng() % TriangleBlock::WIDTH));
+        test.rays.push_back(Ray(eye, (aim - eye).normalized()));
+    }
+    return test;
+}
+
+// Rays that come in almost parallel to the plane of the triangle they are aimed at
+Case grazing(size_t rays) {
+    Case test = cluster(Point(1, 2, 3), 1, Point(0, 0, 0), 0);
+    for (size_t ray = 0; ray < rays; ++ray) {
+        size_t first = 3 * (rng() % TriangleBlock::WIDTH);
+        Point const &a = test.corners[first], &b = test.corners[first + 1], &c = test.corners[first + 2];
+        Vector normal = (b - a).cross(c - a).normalized(), along = normal.cross(randomDirection()).normalized();
+        Vector direction = (along + pow(10.0, uniform(-7, -2)) * normal).normalized();
+        Point aim = nearEdge(test, first);
+        test.rays.push_back(Ray(aim - uniform(0.1, 100) * direction, direction));
+    }
+    return test;
+}
+
+// Shadow and reflection rays: from a point of one triangle of a fan towards the others
+Case fromSurface(size_t rays) {
+    Case test;
+    Point hub(5, 5, 5);
+    vector<Point> rim;
+    for (int corner = 0; corner <= TriangleBlock::WIDTH; ++corner) {
+        double angle = corner * 0.6;
+        rim.push_back(hub + Vector(cos(angle), sin(angle), uniform(-0.2, 0.2)));
+    }
+    for (int triangle = 0; triangle < TriangleBlock::WIDTH; ++triangle) {
+        test.corners.insert(test.corners.end(), {hub, rim[triangle], rim[triangle + 1]});
+    }
+    for (size_t ray = 0; ray < rays; ++ray) {
+        Point origin = nearEdge(test, 3 * (rng() % TriangleBlock::WIDTH));
+        Point aim = nearEdge(test, 3 * (rng() % TriangleBlock::WIDTH));
+        if ((aim - origin).length() > 1e-3) {
+            test.rays.push_back(Ray(origin, (aim - origin).normalized()));
+        }
+    }
+    return test;
+}
+
+// Checks every ray of a case against its block; returns the number of hits a kernel missed
+size_t check(Case const &test, vector<Kernel> const &kernels, size_t &hits) {
+    TriangleBlock block;
+    for (size_t first = 0; first < test.corners.size(); first += 3) {
+        block.add(test.corners[first], test.corners[first + 1], test.corners[first + 2],
+                  static_cast<unsigned>(first / 3));
+    }
+    size_t missed = 0;
+    for (Ray const &ray : test.rays) {
+        vector<double> distances;
+        for (size_t first = 0; first < test.corners.size(); first += 3) {
+            distances.push_back(
+                    Triangle::distance(test.corners[first], test.corners[first + 1], test.corners[first + 2], ray));
+        }
+        // Unbounded, then bounded just beyond every hit
+        vector<double> limits = {numeric_limits<double>::infinity()};
+        for (double t : distances) {
+            if (!std::isnan(t)) {
+                limits.push_back(nextafter(t, numeric_limits<double>::infinity()));
+                ++hits;
+            }
+        }
+        for (double t_max : limits) {
+            unsigned expected = 0;
+            for (unsigned lane = 0; lane < distances.size(); ++lane) {
+                expected |= distances[lane] < t_max ? 1U << lane : 0U;
+            }
+            BlockRay block_ray(block, ray, t_max);
+            for (Kernel const &kernel : kernels) {
+                unsigned lost = expected & ~kernel.kernel(block, block_ray);
+                missed += __builtin_popcount(lost);
+            }
+        }
+    }
+    return missed;
+}
+
+// Checks a number of cases made by make
+size_t checkCases(string const &name, function<Case()> const &make, vector<Kernel> const &kernels) {
+    size_t rays = 0, hits = 0, missed = 0;
+    for (int round = 0; round < 50; ++round) {
+        Case test = make();
+        rays += test.rays.size();
+        missed += check(test, kernels, hits);
+    }
+    printf("%-32s %8zu rays %8zu hits  ", name.c_str(), rays, hits);
+    if (missed == 0) {
+        printf("ok\n");
+    } else {
+        printf("%zu MISSED\n", missed);
+    }
+    return missed;
+}
+
+}
+
+int main() {
+    vector<Kernel> kernels = {{"scalar", intersectBlockScalar}};
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+    kernels.push_back({"sse", intersectBlockSSE});
+    if (__builtin_cpu_supports("avx2")) {
+        kernels.push_back({"avx2", intersectBlockAVX2});
+    }
+#endif
+    printf("Kernels:");
+    for (Kernel const &kernel : kernels) {
+        printf(" %s", kernel.name);
+    }
+    printf("\n");
+
+    Point const origin(0, 0, 0), far(1e5, -2e5, 3e4);
+    size_t missed = 0;
+    missed += checkCases("unit triangles", [&] {
+        return cluster(Point(0, 0, -10), 1, origin, 200);
+    }, kernels);
+    missed += checkCases("small triangles far away", [&] {
+        return cluster(origin, 0.01, origin + 1000 * randomDirection(), 200);
+    }, kernels);
+    missed += checkCases("tiny triangles", [&] {
+        return cluster(origin, 3e-3, origin + 10 * randomDirection(), 200);
+    }, kernels);
+    missed += checkCases("far from the origin", [&] {
+        return cluster(far, 1, far + 20 * randomDirection(), 200);
+    }, kernels);
+    missed += checkCases("slivers", [] {
+        return slivers(200);
+    }, kernels);
+    missed += checkCases("grazing rays", [] {
+        return grazing(200);
+    }, kernels);
+    missed += checkCases("rays from the surface", [] {
+        return fromSurface(200);
+    }, kernels);
+
+    if (missed != 0) {
+        cerr << "The triangle block kernels missed " << missed << " hits of the double precision test\n";
+    }
+    return missed == 0 ? 0 : 1;
+}